@@ -0,0 +1,175 @@
+#include "cloudField.h"
+#include "meshPacker.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <algorithm>
+
+// OpenGL Mathematics
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+// positions of the hand placed clouds, in mesh radius units
+static const float CLOUDS[][3] = {
+  { 1.5f, 1.5f , 1.5f},
+  { 1.0f, 1.35f, 2.6f},
+  { 2.0f, 0.8f ,-0.5f},
+  { 5.0f, 1.0f , 0.3f},
+  {15.0f, 0.6f , 5.4f},
+  {15.0f,-0.4f ,-9.4f},
+  {-2.0f, 1.55f,-1.4f},
+  {-1.3f, 1.30f,-1.0f},
+  {-1.7f, 1.2f , 1.8f}
+};
+static const unsigned int NB_CLOUDS = sizeof(CLOUDS)/sizeof(CLOUDS[0]);
+
+// largest error of a lod on screen, in pixels
+static const float PIXEL_ERROR = 1.0f;
+
+// small deterministic generator: the sky does not change between runs
+static float random01(unsigned int &seed) {
+  seed = seed*1664525u+1013904223u;
+  return (float)(seed>>8)/16777216.0f;
+}
+
+CloudField::CloudField(const Mesh *mesh,unsigned int nbClouds)
+  : _mesh(mesh),
+    _useLod(true),
+    _nbTriangles(0),
+    _vao(0) {
+
+  setNbClouds(nbClouds);
+}
+
+void CloudField::createVAO() {
+  glGenBuffers(3,_buffers);
+  glGenVertexArrays(1,&_vao);
+
+  glBindVertexArray(_vao);
+
+  // interleaved packed positions and normals (see MeshPacker)
+  vector<PackedVertex> packed(_mesh->nb_vertices);
+  if(!packed.empty())
+    MeshPacker::pack(_mesh->vertices,_mesh->normals,_mesh->nb_vertices,_mesh->center,_mesh->radius,&packed[0]);
+
+  glBindBuffer(GL_ARRAY_BUFFER,_buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER,packed.size()*sizeof(PackedVertex),packed.empty() ? NULL : &packed[0],GL_STATIC_DRAW);
+  glVertexAttribPointer(0,3,GL_SHORT,GL_TRUE,sizeof(PackedVertex),(void *)offsetof(PackedVertex,position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1,2,GL_SHORT,GL_TRUE,sizeof(PackedVertex),(void *)offsetof(PackedVertex,normal));
+  glEnableVertexAttribArray(1);
+
+  // indices: the full mesh then the coarser lods
+  const GLsizeiptr full = (GLsizeiptr)_mesh->nb_faces*3*sizeof(unsigned int);
+  const GLsizeiptr lods = (GLsizeiptr)_mesh->nb_lod_faces*3*sizeof(unsigned int);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_buffers[1]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,full+lods,NULL,GL_STATIC_DRAW);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,0,full,_mesh->faces);
+  if(lods>0)
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,full,lods,_mesh->lod_faces);
+
+  // one model matrix per instance: 4 columns, advanced once per cloud
+  // (pointers set by draw, for each lod)
+  for(unsigned int i=0;i<4;++i) {
+    glEnableVertexAttribArray(2+i);
+    glVertexAttribDivisor(2+i,1);
+  }
+
+  glBindVertexArray(0);
+}
+
+void CloudField::deleteVAO() {
+  glDeleteBuffers(3,_buffers);
+  glDeleteVertexArrays(1,&_vao);
+  _vao = 0;
+}
+
+void CloudField::setNbClouds(unsigned int nbClouds) {
+  const float r = _mesh->radius*2.5f;
+  unsigned int seed = 12345u;
+
+  _models.resize(nbClouds);
+  for(unsigned int i=0;i<nbClouds;++i) {
+    glm::vec3 pos;
+    if(i<NB_CLOUDS) {
+      pos = glm::vec3(CLOUDS[i][0],CLOUDS[i][1],CLOUDS[i][2]);
+    } else {
+      // same layer as the hand placed clouds, a bit wider
+      pos.x = -20.0f+40.0f*random01(seed);
+      pos.y = -0.5f +2.1f *random01(seed);
+      pos.z = -10.0f+20.0f*random01(seed);
+    }
+
+    // same transform as the former per-cloud draw
+    glm::mat4 m = glm::scale(glm::mat4(1.0f),glm::vec3(0.0005f));
+    m = glm::rotate(m,(float)90,glm::vec3(0,1,0));
+    m = glm::rotate(m,(float)15,glm::vec3(0,0,1));
+    _models[i] = glm::translate(m,pos*r);
+  }
+}
+
+unsigned int CloudField::selectLod(const glm::mat4 &mdv,const glm::vec4 &center,float pixels) const {
+  // distance to the bounding sphere, scale of the model
+  const float scale = glm::length(glm::vec3(mdv[0]));
+  const float d     = glm::length(glm::vec3(mdv*center))-_mesh->radius*scale;
+  if(d<=0.0f)
+    return 0;
+
+  unsigned int lod = 0;
+  while(lod+1<_mesh->nb_lods && _mesh->lod_error[lod+1]*scale*pixels<=PIXEL_ERROR*d)
+    lod++;
+  return lod;
+}
+
+void CloudField::draw(const Shader *shader,const glm::mat4 &view,const glm::mat4 &proj,int viewportHeight,float y) {
+  _nbTriangles = 0;
+  if(_models.empty() || _mesh->nb_lods==0)
+    return;
+
+  // pixels covered by one unit at distance 1, center of the moved mesh
+  const float pixels = proj[1][1]*0.5f*(float)viewportHeight;
+  const glm::vec4 center(_mesh->center[0]-25.0f*y,_mesh->center[1]+10.0f*sin(y),_mesh->center[2],1.0f);
+
+  // clouds grouped by lod, in one instance buffer
+  unsigned int first[Mesh::MAX_LODS+1] = {0};
+  _lods.resize(_models.size());
+  for(unsigned int i=0;i<_models.size();++i) {
+    _lods[i] = _useLod ? selectLod(view*_models[i],center,pixels) : 0;
+    first[_lods[i]+1]++;
+  }
+  for(unsigned int l=0;l<_mesh->nb_lods;++l)
+    first[l+1] += first[l];
+
+  _sorted.resize(_models.size());
+  unsigned int next[Mesh::MAX_LODS];
+  std::copy(first,first+Mesh::MAX_LODS,next);
+  for(unsigned int i=0;i<_models.size();++i)
+    _sorted[next[_lods[i]]++] = _models[i];
+
+  // bounding sphere of the mesh, to unpack the positions
+  glUniform3fv(shader->uniform("meshCenter"),1,_mesh->center);
+  glUniform1f(shader->uniform("meshRadius"),_mesh->radius);
+
+  glBindVertexArray(_vao);
+  glBindBuffer(GL_ARRAY_BUFFER,_buffers[2]);
+  glBufferData(GL_ARRAY_BUFFER,_sorted.size()*sizeof(glm::mat4),&_sorted[0],GL_STREAM_DRAW);
+
+  for(unsigned int l=0;l<_mesh->nb_lods;++l) {
+    const GLsizei nb = (GLsizei)(first[l+1]-first[l]);
+    if(nb==0)
+      continue;
+
+    // the instances of this lod start at first[l]
+    const size_t base = first[l]*sizeof(glm::mat4);
+    for(unsigned int i=0;i<4;++i)
+      glVertexAttribPointer(2+i,4,GL_FLOAT,GL_FALSE,sizeof(glm::mat4),(void *)(base+i*sizeof(glm::vec4)));
+
+    const size_t offset = (size_t)_mesh->lod_first[l]*3*sizeof(unsigned int);
+    glDrawElementsInstanced(GL_TRIANGLES,3*_mesh->lod_size[l],GL_UNSIGNED_INT,(void *)offset,nb);
+    _nbTriangles += _mesh->lod_size[l]*(unsigned int)nb;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  glBindVertexArray(0);
+}
@@ -0,0 +1,60 @@
+#ifndef CLOUD_FIELD_H
+#define CLOUD_FIELD_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// OpenGL Mathematics
+#include <glm/glm.hpp>
+
+#include "meshLoader.h"
+#include "shader.h"
+
+// All the clouds of the sky drawn with one glDrawElementsInstanced per
+// level of detail. The cloud mesh is stored once with the triangles of
+// all its lods (see Mesh) and each instance gets its model matrix from an
+// instance buffer (attributes 2 to 5 of shaders/cloud.vert). Vertices are
+// uploaded packed (see MeshPacker). Every frame, each cloud takes the
+// coarsest lod whose error stays under a pixel on screen. The first
+// clouds are the hand placed ones, the others are scattered around them.
+class CloudField {
+ public:
+  CloudField(const Mesh *mesh,unsigned int nbClouds=9);
+
+  // GPU objects (need a current OpenGL context)
+  void createVAO();
+  void deleteVAO();
+
+  // rebuild (and upload, if the VAO exists) the instance transforms
+  void setNbClouds(unsigned int nbClouds);
+
+  // draw all the clouds with the given program (in use, FrameData set),
+  // seen through view/proj in a viewport of the given height, at time y
+  // (the shader moves the mesh with it)
+  void draw(const Shader *shader,const glm::mat4 &view,const glm::mat4 &proj,int viewportHeight,float y);
+
+  // lods on, or full resolution everywhere
+  inline void setUseLod(bool use) {_useLod = use;}
+  inline bool useLod() const {return _useLod;}
+
+  inline unsigned int nbClouds() const {return (unsigned int)_models.size();}
+
+  // triangles sent by the last draw
+  inline unsigned int nbTriangles() const {return _nbTriangles;}
+
+ private:
+  unsigned int selectLod(const glm::mat4 &mdv,const glm::vec4 &center,float pixels) const;
+
+  const Mesh *_mesh;
+
+  std::vector<glm::mat4>    _models; // model matrix of each cloud
+  std::vector<glm::mat4>    _sorted; // the same, grouped by lod for the draw
+  std::vector<unsigned int> _lods;   // lod of each cloud this frame
+  bool         _useLod;
+  unsigned int _nbTriangles;
+
+  GLuint _vao;
+  GLuint _buffers[3]; // packed vertices, indices (all the lods), instances
+};
+
+#endif // CLOUD_FIELD_H
@@ -0,0 +1,48 @@
+#include "fileUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+bool readAll(int fd,void *data,size_t size) {
+  char *p = (char *)data;
+  while(size>0) {
+    const ssize_t n = read(fd,p,size);
+    if(n<=0)
+      return false;
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+bool writeAll(int fd,const void *data,size_t size) {
+  const char *p = (const char *)data;
+  while(size>0) {
+    const ssize_t n = write(fd,p,size);
+    if(n<=0)
+      return false;
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+bool writeFileAtomic(const string &path,const function<bool(int fd)> &write) {
+  string tmp = path+".XXXXXX";
+  const int fd = mkstemp(&tmp[0]);
+  if(fd<0)
+    return false;
+
+  // mkstemp creates the file for its owner only
+  const bool ok = fchmod(fd,0644)==0 && write(fd);
+  if(close(fd)!=0 || !ok || rename(tmp.c_str(),path.c_str())!=0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
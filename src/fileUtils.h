@@ -0,0 +1,19 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+
+// Helpers of the binary caches (MeshCache, ProgramCache, Texture).
+
+// read or write exactly size bytes, false on error or end of file
+bool readAll(int fd,void *data,size_t size);
+bool writeAll(int fd,const void *data,size_t size);
+
+// write the file with write(fd) into a temporary file of its own, renamed
+// to path once complete: a reader never sees a partial file, and
+// concurrent writers of the same path do not mix their data
+bool writeFileAtomic(const std::string &path,const std::function<bool(int fd)> &write);
+
+#endif // FILE_UTILS_H
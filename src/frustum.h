@@ -0,0 +1,52 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+// OpenGL Mathematics
+#include <glm/glm.hpp>
+
+// view frustum planes extracted from a projection*modelview matrix
+class Frustum {
+ public:
+  Frustum() {}
+  Frustum(const glm::mat4 &m) {set(m);}
+
+  inline void set(const glm::mat4 &m);
+
+  // false if the box is completely outside one of the planes
+  inline bool intersects(const glm::vec3 &bmin,const glm::vec3 &bmax) const;
+
+ private:
+  glm::vec4 _planes[6]; // (normal,distance), pointing inside
+};
+
+inline void Frustum::set(const glm::mat4 &m) {
+  // rows of the (column major) matrix
+  glm::vec4 r[4];
+  for(int i=0;i<4;++i)
+    r[i] = glm::vec4(m[0][i],m[1][i],m[2][i],m[3][i]);
+
+  _planes[0] = r[3]+r[0]; // left
+  _planes[1] = r[3]-r[0]; // right
+  _planes[2] = r[3]+r[1]; // bottom
+  _planes[3] = r[3]-r[1]; // top
+  _planes[4] = r[3]+r[2]; // near
+  _planes[5] = r[3]-r[2]; // far
+}
+
+inline bool Frustum::intersects(const glm::vec3 &bmin,const glm::vec3 &bmax) const {
+  for(int i=0;i<6;++i) {
+    const glm::vec4 &p = _planes[i];
+
+    // corner of the box the furthest along the normal
+    const glm::vec3 c(p.x>=0.0f ? bmax.x : bmin.x,
+		      p.y>=0.0f ? bmax.y : bmin.y,
+		      p.z>=0.0f ? bmax.z : bmin.z);
+
+    if(p.x*c.x+p.y*c.y+p.z*c.z+p.w<0.0f)
+      return false;
+  }
+
+  return true;
+}
+
+#endif // FRUSTUM_H
@@ -1,47 +1,234 @@
 #include "grid.h"
 
+#include <algorithm>
+
 using namespace std; 
 
-Grid::Grid(unsigned int size,float minval,float maxval) {
+namespace {
+
+// cell rows (or vertex rows) per task
+const unsigned int GRAIN = 16;
+
+// indices of a row of cells of a band
+inline unsigned int rowIndices(Grid::Topology topology,unsigned int cells) {
+  return topology==Grid::STRIPS ? 2*(cells+1)+1 : 6*cells;
+}
+
+// size bytes written by fill in the buffer bound to target: in place when
+// it can be mapped, else (or when its content was lost) through a copy
+void fillBuffer(GLenum target,size_t size,const function<void(void *)> &fill) {
+  glBufferData(target,size,NULL,GL_STATIC_DRAW);
+  void *data = glMapBufferRange(target,0,size,GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_BUFFER_BIT);
+  if(data) {
+    fill(data);
+    if(glUnmapBuffer(target)==GL_TRUE)
+      return;
+  }
+
+  vector<char> copy(size);
+  fill(&copy[0]);
+  glBufferSubData(target,0,size,&copy[0]);
+}
+
+} // namespace
+
+Grid::Grid(unsigned int size,float minval,float maxval,unsigned int patchCells,
+	   Topology topology)
+  : _size(size),
+    _topology(topology) {
   const float w = maxval-minval;
-  const float h = w;
-
-  const float stepW  = w/(float)size;
-  const float stepH  = h/(float)size;
-  const float startx = minval;
-  const float starty = minval;
-
-  for(unsigned int i=0;i<size;++i) {
-    for(unsigned int j=0;j<size;++j) {
-      
-      const float currentx = startx+stepW*(float)j;
-      const float currenty = starty+stepH*(float)i;
-     
-      _vertices.push_back(currentx);
-      _vertices.push_back(currenty);
-      _vertices.push_back(0.0f);
-
-      if(i>0 && j>0) {
-	int i1 = i*size+j;
-	int i2 = (i-1)*size+j;
-	int i3 = (i-1)*size+j-1;
-	int i4 = i*size+j-1;
-	
-	_faces.push_back(i1);
-	_faces.push_back(i2);
-	_faces.push_back(i3);
-	_faces.push_back(i3);
-	_faces.push_back(i4);
-	_faces.push_back(i1);
-      }
+
+  _origin = minval;
+  _step   = w/(float)size;
+
+  // cells are (i-1,i)x(j-1,j) for i,j in [1,size)
+  const unsigned int cells = size-1;
+  if(patchCells==0 || patchCells>cells)
+    patchCells = cells;
+  _patchCells = patchCells;
+
+  // small grid: plain 16-bit indices, else relative to the patch corner
+  // (0xffff restarts the strips)
+  const size_t maxShort = topology==STRIPS ? 0xfffe : 0xffff;
+  const bool small = (size_t)size*size-1<=maxShort;
+  bool fits = true;
+
+  const unsigned int nbPatches = (cells+patchCells-1)/patchCells;
+  _patches.reserve(nbPatches*nbPatches);
+
+  size_t nbIndices = 0;
+  for(unsigned int pi=0;pi<cells;pi+=patchCells) {
+    for(unsigned int pj=0;pj<cells;pj+=patchCells) {
+      const unsigned int iend = min(pi+patchCells,cells);
+      const unsigned int jend = min(pj+patchCells,cells);
+
+      GridPatch p;
+      p.firstIndex = (unsigned int)nbIndices;
+      p.baseVertex = small ? 0 : pi*size+pj;
+      p.xmin = _origin+_step*(float)pj;
+      p.xmax = _origin+_step*(float)jend;
+      p.ymin = _origin+_step*(float)pi;
+      p.ymax = _origin+_step*(float)iend;
+
+      fits = fits && iend*size+jend-p.baseVertex<=maxShort;
+
+      // full bands, then the remaining columns
+      const unsigned int width = jend-pj;
+      const unsigned int band  = topology==ROWS ? width : BAND_CELLS;
+      const unsigned int rest  = width%band;
+      p.nbIndices = (iend-pi)*((width/band)*rowIndices(topology,band)+
+			       (rest>0 ? rowIndices(topology,rest) : 0));
+
+      nbIndices += p.nbIndices;
+      _patches.push_back(p);
     }
   }
 
-  _nbVertices = _vertices.size()/3;
-  _nbFaces    = _faces.size()/3;
+  _nbVertices   = size*size;
+  _nbFaces      = 2*cells*cells;
+  _nbIndices    = (unsigned int)nbIndices;
+  _shortIndices = fits;
+
+  if(!fits) {
+    for(unsigned int k=0;k<_patches.size();++k)
+      _patches[k].baseVertex = 0;
+  }
+
+  // one range per base vertex (a single one for small grids)
+  for(unsigned int k=0;k<_patches.size();++k) {
+    const GridPatch &p = _patches[k];
+    if(!_counts.empty() && _bases.back()==(GLint)p.baseVertex) {
+      _counts.back() += p.nbIndices;
+      continue;
+    }
+    _counts.push_back(p.nbIndices);
+    _offsets.push_back((const GLvoid *)((size_t)p.firstIndex*indexSize()));
+    _bases.push_back((GLint)p.baseVertex);
+  }
 }
 
 Grid::~Grid() {
-  _vertices.clear();
-  _faces.clear();
+  _patches.clear();
+}
+
+template<typename T> void Grid::fillRows(T *indices,bool relative,unsigned int first,unsigned int last) const {
+  const unsigned int cells    = _size-1;
+  const unsigned int nbPatchX = (cells+_patchCells-1)/_patchCells;
+  const T            restart  = (T)-1;
+
+  for(unsigned int r=first;r<last;++r) {
+    const unsigned int i  = r+1;
+    const unsigned int pi = r-r%_patchCells;
+
+    for(unsigned int k=0;k<nbPatchX;++k) {
+      const GridPatch   &p    = _patches[(r/_patchCells)*nbPatchX+k];
+      const unsigned int pj   = k*_patchCells;
+      const unsigned int iend = min(pi+_patchCells,cells);
+      const unsigned int jend = min(pj+_patchCells,cells);
+      const unsigned int base = relative ? p.baseVertex : 0;
+      const unsigned int band = _topology==ROWS ? jend-pj : BAND_CELLS;
+
+      // the bands of the patch follow each other, rows inside
+      T *band0 = indices+p.firstIndex;
+      for(unsigned int bj=pj;bj<jend;bj+=band) {
+	const unsigned int bend = min(bj+band,jend);
+	const unsigned int n    = rowIndices(_topology,bend-bj);
+	T *f = band0+(r-pi)*n;
+	band0 += (iend-pi)*n;
+
+	if(_topology==STRIPS) {
+	  // same diagonals as the triangles below
+	  for(unsigned int j=bj;j<=bend;++j) {
+	    *f++ = (T)(i*_size+j-base);
+	    *f++ = (T)((i-1)*_size+j-base);
+	  }
+	  *f = restart;
+	  continue;
+	}
+
+	for(unsigned int j=bj+1;j<=bend;++j) {
+	  const T i1 = (T)(i*_size+j-base);
+	  const T i2 = (T)((i-1)*_size+j-base);
+	  const T i3 = (T)((i-1)*_size+j-1-base);
+	  const T i4 = (T)(i*_size+j-1-base);
+
+	  f[0] = i1; f[1] = i2; f[2] = i3;
+	  f[3] = i3; f[4] = i4; f[5] = i1;
+	  f += 6;
+	}
+      }
+    }
+  }
+}
+
+template<typename T> void Grid::fillAll(T *indices,bool relative,ThreadPool *pool) const {
+  forRange(pool,_size-1,GRAIN,[&](unsigned int first,unsigned int last) {
+      fillRows(indices,relative,first,last);
+    });
+}
+
+void Grid::fillCoords(unsigned short *coords,ThreadPool *pool) const {
+  forRange(pool,_size,GRAIN,[&](unsigned int first,unsigned int last) {
+      for(unsigned int i=first;i<last;++i) {
+	unsigned short *c = coords+2*(size_t)i*_size;
+	for(unsigned int j=0;j<_size;++j) {
+	  c[2*j  ] = (unsigned short)j;
+	  c[2*j+1] = (unsigned short)i;
+	}
+      }
+    });
+}
+
+void Grid::fillFaces(int *faces,ThreadPool *pool) const {
+  fillAll(faces,false,pool);
+}
+
+void Grid::fillIndices(void *indices,ThreadPool *pool) const {
+  if(shortIndices())
+    fillAll((unsigned short *)indices,true,pool);
+  else
+    fillAll((int *)indices,false,pool);
+}
+
+void Grid::upload(GLuint vertexBuffer,GLuint indexBuffer,ThreadPool *pool) const {
+  glBindBuffer(GL_ARRAY_BUFFER,vertexBuffer);
+  fillBuffer(GL_ARRAY_BUFFER,2*(size_t)_nbVertices*sizeof(unsigned short),[&](void *data) {
+      fillCoords((unsigned short *)data,pool);
+    });
+  glVertexAttribPointer(0,2,GL_UNSIGNED_SHORT,GL_FALSE,0,(void *)0);
+  glEnableVertexAttribArray(0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,indexBuffer);
+  fillBuffer(GL_ELEMENT_ARRAY_BUFFER,(size_t)_nbIndices*indexSize(),[&](void *data) {
+      fillIndices(data,pool);
+    });
+}
+
+void Grid::setUniform(const Shader *shader) const {
+  glUniform2f(shader->uniform("grid"),_origin,_step);
+}
+
+void Grid::draw(bool patches) const {
+  draw(&_counts[0],&_offsets[0],&_bases[0],(GLsizei)_counts.size(),patches);
+}
+
+void Grid::draw(const GLsizei *counts,const GLvoid *const *offsets,const GLint *bases,GLsizei nb,
+		bool patches) const {
+  if(nb==0)
+    return;
+
+  GLenum mode = patches ? GL_PATCHES : GL_TRIANGLES;
+  if(_topology==STRIPS) {
+    mode = GL_TRIANGLE_STRIP;
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(shortIndices() ? 0xffffu : 0xffffffffu);
+  }
+
+  if(nb==1 && bases[0]==0)
+    glDrawElements(mode,counts[0],indexType(),offsets[0]);
+  else
+    glMultiDrawElementsBaseVertex(mode,counts,indexType(),offsets,nb,(GLint *)bases);
+
+  if(_topology==STRIPS)
+    glDisable(GL_PRIMITIVE_RESTART);
 }
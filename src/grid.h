@@ -1,25 +1,112 @@
 #ifndef GRID_H 
 #define GRID_H
 
+#include <GL/glew.h>
 #include <vector>
 
+#include "shader.h"
+#include "threadPool.h"
+
+// square block of cells whose indices are contiguous in faces()
+struct GridPatch {
+  unsigned int firstIndex;
+  unsigned int nbIndices;
+  unsigned int baseVertex; // of the 16-bit indices of the patch
+  float xmin,xmax;
+  float ymin,ymax;
+};
+
+// Regular grid of size x size vertices on [minval,maxval). On the GPU a
+// vertex is its column and row (2 unsigned shorts), placed by the shaders
+// at origin+step*(column,row) (uniform "grid"), and the indices are 16
+// bits whenever they fit: directly below 65536 vertices, else relative to
+// the first vertex of their patch (drawn with a base vertex).
+//
+// Inside a patch, the cells are sent row by row (ROWS: about 1 vertex
+// shader run per triangle), or in bands of BAND_CELLS columns so that the
+// vertices of a row are still in the post transform cache (16 entries or
+// more) when the next row uses them (BANDS: about 0.6 run per triangle),
+// or the same bands as triangle strips, one per row, separated by a
+// primitive restart index (STRIPS: 2 indices per cell instead of 6, wound
+// the other way round).
+//
+// The constructor only lays out the patches: the number of indices of
+// each one is known up front, so the coordinates and indices are written
+// afterwards at their final place, rows in parallel with a pool, straight
+// into mapped GL buffers by upload (no copy on the CPU side).
 class Grid {
  public:
-  Grid(unsigned int size=1024,float minval=-1.0f,float maxval=1.0f);
+  enum Topology {ROWS,BANDS,STRIPS,NB_TOPOLOGIES};
+  static const unsigned int BAND_CELLS = 6;
+
+  // faces are grouped by patches of patchCells x patchCells cells
+  // (0: a single patch)
+  Grid(unsigned int size=1024,float minval=-1.0f,float maxval=1.0f,unsigned int patchCells=0,
+       Topology topology=ROWS);
   ~Grid();
 
   inline unsigned int nbVertices() const {return _nbVertices;}
   inline unsigned int nbFaces   () const {return _nbFaces;   }
+  inline unsigned int nbIndices () const {return _nbIndices; }
+  inline unsigned int nbPatches () const {return (unsigned int)_patches.size();}
+  inline Topology     topology  () const {return _topology;  }
+
+  inline float origin() const {return _origin;}
+  inline float step  () const {return _step;  }
+
+  // what the GPU gets: 16-bit indices (relative to the baseVertex of
+  // their patch) or 32-bit ones
+  inline bool         shortIndices() const {return _shortIndices;}
+  inline GLenum       indexType   () const {return shortIndices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;}
+  inline unsigned int indexSize   () const {return shortIndices() ? sizeof(unsigned short) : sizeof(int);}
+
+  inline const GridPatch &patch(unsigned int i) const {return _patches[i];}
 
-  inline float *vertices() {return &_vertices[0];}
-  inline int   *faces   () {return &_faces[0];   }
+  // column and row of each vertex (2*nbVertices() values)
+  void fillCoords(unsigned short *coords,ThreadPool *pool=NULL) const;
+
+  // 32-bit indices of the whole grid (nbIndices() values, -1 restarts
+  // the strips)
+  void fillFaces(int *faces,ThreadPool *pool=NULL) const;
+
+  // indices as sent to the GPU (nbIndices() values of indexType())
+  void fillIndices(void *indices,ThreadPool *pool=NULL) const;
+
+  // generate the coordinates (attribute 0) and the indices in the
+  // buffers of the bound VAO
+  void upload(GLuint vertexBuffer,GLuint indexBuffer,ThreadPool *pool=NULL) const;
+
+  // origin and step of the grid for the shader
+  void setUniform(const Shader *shader) const;
+
+  // draw all the faces, or the given ranges of indices (the VAO must be
+  // bound). patches: as GL_PATCHES of 3 vertices (not for STRIPS)
+  void draw(bool patches=false) const;
+  void draw(const GLsizei *counts,const GLvoid *const *offsets,const GLint *bases,GLsizei nb,
+	    bool patches=false) const;
   
  private:
+  // indices of the cell rows [first,last) of every patch crossing them,
+  // relative to the base vertex of their patch or not
+  template<typename T> void fillRows(T *indices,bool relative,unsigned int first,unsigned int last) const;
+  template<typename T> void fillAll(T *indices,bool relative,ThreadPool *pool) const;
+
+  unsigned int _size;
+  unsigned int _patchCells;
   unsigned int _nbVertices;
   unsigned int _nbFaces;
+  unsigned int _nbIndices;
+  Topology     _topology;
+  float        _origin;
+  float        _step;
+  bool         _shortIndices;
+
+  std::vector<GridPatch>      _patches; // row by row
 
-  std::vector<float> _vertices;
-  std::vector<int>   _faces;
+  // ranges of the index buffer sharing a base vertex (see draw)
+  std::vector<GLsizei>        _counts;
+  std::vector<const GLvoid *> _offsets;
+  std::vector<GLint>          _bases;
 };
 
 #endif //GRID_H
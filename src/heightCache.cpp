@@ -0,0 +1,123 @@
+#include "heightCache.h"
+
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+HeightCache::HeightCache(unsigned int width,unsigned int height,
+			 float xmin,float xmax,float ystart,float yend)
+  : _width(width),
+    _height(height),
+    _xmin(xmin),
+    _xstep((xmax-xmin)/(float)width),
+    _ystart(ystart),
+    _ystep((yend-ystart)/(float)height),
+    _valid(false),
+    _first(0),
+    _last(0),
+    _nbUpdatedRows(0),
+    _shader(NULL),
+    _texId(0),
+    _fbo(0),
+    _vao(0) {
+
+}
+
+HeightCache::~HeightCache() {
+  delete _shader;
+}
+
+void HeightCache::create() {
+  _shader = new Shader();
+  _shader->load("shaders/heightcache.vert","shaders/heightcache.frag");
+
+  // ring buffer texture: wraps along y only
+  glGenTextures(1,&_texId);
+  glBindTexture(GL_TEXTURE_2D,_texId);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,_width,_height,0,GL_RGBA,GL_FLOAT,NULL);
+
+  glGenFramebuffers(1,&_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER,_fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,_texId,0);
+  glBindFramebuffer(GL_FRAMEBUFFER,0);
+
+  // the full screen triangle has no attribute, but core profile wants a VAO
+  glGenVertexArrays(1,&_vao);
+
+  _valid = false;
+}
+
+void HeightCache::destroy() {
+  glDeleteVertexArrays(1,&_vao);
+  glDeleteFramebuffers(1,&_fbo);
+  glDeleteTextures(1,&_texId);
+  delete _shader;
+  _shader = NULL;
+}
+
+void HeightCache::computeRows(long first,long last) {
+  // split the range where it wraps around the texture
+  while(first<=last) {
+    const long texRow = ((first%(long)_height)+(long)_height)%(long)_height;
+    const long nb     = min(last-first+1,(long)_height-texRow);
+
+    glViewport(0,(GLint)texRow,_width,(GLsizei)nb);
+    glUniform4f(_shader->uniform("rows"),_xmin,_xstep,(float)((double)first*(double)_ystep),_ystep);
+    glUniform1f(_shader->uniform("texFirst"),(float)texRow);
+    glDrawArrays(GL_TRIANGLES,0,3);
+
+    _nbUpdatedRows += (unsigned int)nb;
+    first += nb;
+  }
+}
+
+void HeightCache::update(float y) {
+  // rows needed to cover [y+ystart,y+yend)
+  const long first = (long)floor(((double)y+(double)_ystart)/(double)_ystep);
+  const long last  = first+(long)_height-1;
+
+  _nbUpdatedRows = 0;
+  if(_valid && first==_first && last==_last)
+    return;
+
+  glBindFramebuffer(GL_FRAMEBUFFER,_fbo);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  glUseProgram(_shader->id());
+  glBindVertexArray(_vao);
+
+  if(!_valid || last<_first || first>_last) {
+    // nothing to keep
+    computeRows(first,last);
+  } else {
+    // only the rows that were not in the cache (forward or backward motion)
+    if(first<_first) computeRows(first,_first-1);
+    if(last>_last)   computeRows(_last+1,last);
+  }
+
+  glBindVertexArray(0);
+  glUseProgram(0);
+  glBindFramebuffer(GL_FRAMEBUFFER,0);
+
+  _valid = true;
+  _first = first;
+  _last  = last;
+}
+
+void HeightCache::bind(const Shader *shader,GLuint unit) {
+  glActiveTexture(GL_TEXTURE0+unit);
+  glBindTexture(GL_TEXTURE_2D,_texId);
+  glUniform1i(shader->uniform("heightCache"),unit);
+
+  // area (terrain space) where both rows of the bilinear fetch are valid
+  glUniform4f(shader->uniform("cacheArea"),
+	      _xmin,_xmin+_xstep*(float)(_width-1),
+	      _ystart,_ystart+_ystep*(float)(_height-2));
+  glUniform4f(shader->uniform("cacheStep"),
+	      _xstep,_ystep,(float)_width,(float)_height);
+}
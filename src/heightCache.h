@@ -0,0 +1,58 @@
+#ifndef HEIGHT_CACHE_H
+#define HEIGHT_CACHE_H
+
+#include <GL/glew.h>
+
+#include "shader.h"
+
+// Terrain heights and normals cached in a RGBA32F texture (normal in xyz,
+// height in w). Texture rows are used as a ring buffer along y: when _y
+// advances, only the rows that scrolled in are computed (render to texture
+// with shaders/heightcache.*), the vertex shader then fetches the texture
+// instead of evaluating the noise.
+class HeightCache {
+ public:
+  HeightCache(unsigned int width=512,unsigned int height=512,
+	      float xmin=-1.0f,float xmax=1.0f,float ystart=-1.0f,float yend=1.0f);
+  ~HeightCache();
+
+  // GPU objects (need a current OpenGL context)
+  void create();
+  void destroy();
+
+  // recompute all the rows at the next update (the height function of the
+  // shader may have changed)
+  inline void invalidate() {_valid = false;}
+
+  // compute the rows that entered the cached area for offset y
+  void update(float y);
+
+  // bind the texture on the given unit and send the uniforms to the program
+  void bind(const Shader *shader,GLuint unit);
+
+  inline unsigned int nbUpdatedRows() const {return _nbUpdatedRows;}
+  inline Shader      *shader       () const {return _shader;       }
+
+ private:
+  void computeRows(long first,long last);
+
+  unsigned int _width;
+  unsigned int _height;
+  float        _xmin;
+  float        _xstep;
+  float        _ystart;
+  float        _ystep;
+
+  // rows (absolute index along y) currently stored in the texture
+  bool _valid;
+  long _first;
+  long _last;
+  unsigned int _nbUpdatedRows;
+
+  Shader *_shader;
+  GLuint  _texId;
+  GLuint  _fbo;
+  GLuint  _vao;
+};
+
+#endif // HEIGHT_CACHE_H
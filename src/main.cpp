@@ -1,9 +1,14 @@
 #include <qapplication.h>
 #include <QString>
+#include <QTime>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <algorithm>
 #include "viewer.h"
+#include "terrainBaker.h"
+#include "offReader.h"
 
 using namespace std;
 
@@ -17,7 +22,85 @@ char *getFilename(int ,char **argv) {
 }
 
 
+// terrain --bake width height [xmin xmax ymin ymax] [prefix]
+int bake(int argc,char **argv) {
+  if(argc<4) {
+    cout << "Usage: " << argv[0] << " --bake width height [xmin xmax ymin ymax] [prefix]" << endl;
+    return 1;
+  }
+
+  const unsigned int width  = (unsigned int)atoi(argv[2]);
+  const unsigned int height = (unsigned int)atoi(argv[3]);
+  float bounds[4] = {-1.0f,1.0f,-1.0f,1.0f};
+  const char *prefix = "terrain";
+
+  int i = 4;
+  if(argc>=8) {
+    for(int j=0;j<4;++j)
+      bounds[j] = (float)atof(argv[4+j]);
+    i = 8;
+  }
+  if(argc>i)
+    prefix = argv[i];
+
+  ThreadPool pool;
+  TerrainBaker baker(width,height,bounds[0],bounds[1],bounds[2],bounds[3]);
+
+  QTime timer;
+  timer.start();
+  if(!baker.bake(string(prefix)+"_height.pfm",string(prefix)+"_normal.pfm",pool))
+    return 1;
+  cout << "Done in " << timer.elapsed() << " ms" << endl;
+
+  return 0;
+}
+
+// terrain --bench-off file.off [nbRuns]
+int benchOff(int argc,char **argv) {
+  if(argc<3) {
+    cout << "Usage: " << argv[0] << " --bench-off file.off [nbRuns]" << endl;
+    return 1;
+  }
+
+  const int nbRuns = argc>3 ? max(1,atoi(argv[3])) : 3;
+  const char *names[3] = {"fscanf","tokenizer","parallel"};
+  ThreadPool pool;
+
+  cout << pool.nbThreads() << " threads" << endl;
+  for(int r=0;r<3;++r) {
+    int best = -1;
+    for(int i=0;i<nbRuns;++i) {
+      OffData data;
+      string error;
+      QTime timer;
+      timer.start();
+      const bool loaded = r==0 ? readOffScanf(argv[2],data,error) :
+	                  readOff(argv[2],data,error,r==2 ? &pool : NULL);
+      if(!loaded) {
+	cout << names[r] << ": " << error << endl;
+	break;
+      }
+      const int elapsed = timer.elapsed();
+      best = best<0 ? elapsed : min(best,elapsed);
+      if(i==0)
+	cout << names[r] << ": " << data.nbVertices << " vertices, " << data.nbFaces << " triangles" << endl;
+      free(data.vertices);
+      free(data.faces);
+    }
+    if(best>=0)
+      cout << names[r] << ": best of " << nbRuns << " runs: " << best << " ms" << endl;
+  }
+
+  return 0;
+}
+
 int main(int argc,char** argv) {
+  // offline modes: no window
+  if(argc>1 && strcmp(argv[1],"--bake")==0)
+    return bake(argc,argv);
+  if(argc>1 && strcmp(argv[1],"--bench-off")==0)
+    return benchOff(argc,argv);
+
   QApplication application(argc,argv);
 
   QGLFormat fmt;
@@ -8,8 +8,12 @@ TARGET    = terrain
 LIBS     += -lGLEW -lGL -lGLU -lm
 INCLUDEPATH  += $${GLEW_PATH}/include  $${GLM_PATH}
 
-SOURCES   = shader.cpp grid.cpp trackball.cpp camera.cpp viewer.cpp main.cpp meshloader.cpp
-HEADERS   = shader.h grid.h trackball.h camera.h viewer.h meshloader.h
+SOURCES   = shader.cpp grid.cpp trackball.cpp camera.cpp viewer.cpp main.cpp meshloader.cpp terrainChunks.cpp terrainLod.cpp terrainClipmap.cpp heightCache.cpp terrainFunction.cpp threadPool.cpp terrainBaker.cpp terrainTess.cpp terrainCulling.cpp cloudField.cpp offReader.cpp meshCache.cpp meshNormals.cpp meshOptimizer.cpp meshSimplifier.cpp meshPacker.cpp fileUtils.cpp programCache.cpp shaderManager.cpp texture.cpp textureCompressor.cpp textureLoader.cpp
+HEADERS   = shader.h grid.h trackball.h camera.h viewer.h meshloader.h terrainChunks.h terrainLod.h terrainClipmap.h heightCache.h terrainFunction.h threadPool.h terrainBaker.h terrainTess.h terrainCulling.h frustum.h cloudField.h offReader.h meshCache.h meshNormals.h meshOptimizer.h meshSimplifier.h meshPacker.h fileUtils.h programCache.h shaderManager.h texture.h textureCompressor.h textureLoader.h simd.h
+
+# the SIMD and scalar terrain functions must round the same way
+# (add -mavx2 or -march=native to get the AVX2 batch functions)
+QMAKE_CXXFLAGS += -ffp-contract=off
 
 CONFIG   += qt opengl warn_on thread uic4 release
 QT       *= xml opengl core
@@ -0,0 +1,187 @@
+#include "meshCache.h"
+#include "meshLoader.h"
+#include "fileUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+const char     MAGIC[8]   = "SIMMESH";
+const uint32_t ENDIANNESS = 0x01020304u;
+const size_t   SAMPLE     = 4096;
+
+struct Source {
+  uint64_t size;
+  int64_t  mtime;
+  uint64_t hash;
+};
+
+// FNV-1a
+uint64_t hashBytes(const char *p,size_t n,uint64_t h) {
+  for(size_t i=0;i<n;++i)
+    h = (h^(unsigned char)p[i])*1099511628211ull;
+  return h;
+}
+
+// size, date and sampled content of the source file
+bool describe(const char *source,Source &s) {
+  const int fd = open(source,O_RDONLY);
+  if(fd<0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd,&st)!=0) {
+    close(fd);
+    return false;
+  }
+
+  s.size  = (uint64_t)st.st_size;
+  s.mtime = (int64_t)st.st_mtim.tv_sec*1000000000+st.st_mtim.tv_nsec;
+  s.hash  = 14695981039346656037ull;
+
+  // first and last pages: catch rewrites that keep size and date
+  char buffer[SAMPLE];
+  const off_t offsets[2] = {0,st.st_size>(off_t)SAMPLE ? st.st_size-(off_t)SAMPLE : 0};
+  for(int i=0;i<2;++i) {
+    const ssize_t n = pread(fd,buffer,SAMPLE,offsets[i]);
+    if(n<0) {
+      close(fd);
+      return false;
+    }
+    s.hash = hashBytes(buffer,(size_t)n,s.hash);
+  }
+
+  close(fd);
+  return true;
+}
+
+inline uint64_t align(uint64_t n) {
+  return (n+MeshCache::BLOB_ALIGN-1)/MeshCache::BLOB_ALIGN*MeshCache::BLOB_ALIGN;
+}
+
+} // namespace
+
+string MeshCache::path(const char *source) {
+  return string(source)+".mesh";
+}
+
+bool MeshCache::load(const char *source,Mesh &mesh) {
+  Source s;
+  if(!describe(source,s))
+    return false;
+
+  const string file = path(source);
+  const int fd = open(file.c_str(),O_RDONLY);
+  if(fd<0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd,&st)!=0 || (size_t)st.st_size<sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+
+  // private mapping: the mesh may modify its arrays (copy on write)
+  void *p = mmap(NULL,(size_t)st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(p==MAP_FAILED)
+    return false;
+
+  const Header &h = *(const Header *)p;
+  const uint64_t nv = (uint64_t)h.nbVertices*3*sizeof(float);
+  const uint64_t nf = (uint64_t)h.nbFaces*3*sizeof(unsigned int);
+  const uint64_t nl = (uint64_t)h.nbLodFaces*3*sizeof(unsigned int);
+  bool lods = h.nbLods>=1 && h.nbLods<=Mesh::MAX_LODS;
+  for(uint32_t i=0;i<h.nbLods && lods;++i)
+    lods = (uint64_t)h.lodFirst[i]+h.lodSize[i]<=(uint64_t)h.nbFaces+h.nbLodFaces;
+  const bool valid = lods &&
+    memcmp(h.magic,MAGIC,sizeof(MAGIC))==0 && h.version==VERSION && h.endianness==ENDIANNESS &&
+    h.fileSize==(uint64_t)st.st_size &&
+    h.sourceSize==s.size && h.sourceMtime==s.mtime && h.sourceHash==s.hash &&
+    h.offsets[0]>=sizeof(Header) && h.offsets[0]%BLOB_ALIGN==0 &&
+    h.offsets[1]>=h.offsets[0]+nv && h.offsets[1]%BLOB_ALIGN==0 &&
+    h.offsets[2]>=h.offsets[1]+nv && h.offsets[2]%BLOB_ALIGN==0 &&
+    h.offsets[3]>=h.offsets[2]+nv && h.offsets[3]%BLOB_ALIGN==0 &&
+    h.offsets[4]>=h.offsets[3]+nf && h.offsets[4]%BLOB_ALIGN==0 &&
+    h.offsets[4]+nl<=h.fileSize;
+
+  if(!valid) {
+    munmap(p,(size_t)st.st_size);
+    return false;
+  }
+
+  char *base = (char *)p;
+  mesh.nb_vertices = h.nbVertices;
+  mesh.nb_faces    = h.nbFaces;
+  mesh.vertices    = (float *)(base+h.offsets[0]);
+  mesh.normals     = (float *)(base+h.offsets[1]);
+  mesh.colors      = (float *)(base+h.offsets[2]);
+  mesh.faces       = (unsigned int *)(base+h.offsets[3]);
+  memcpy(mesh.center,h.center,sizeof(mesh.center));
+  mesh.radius      = h.radius;
+  mesh.nb_lods      = h.nbLods;
+  mesh.nb_lod_faces = h.nbLodFaces;
+  mesh.lod_faces    = (unsigned int *)(base+h.offsets[4]);
+  memcpy(mesh.lod_first,h.lodFirst,sizeof(mesh.lod_first));
+  memcpy(mesh.lod_size,h.lodSize,sizeof(mesh.lod_size));
+  memcpy(mesh.lod_error,h.lodError,sizeof(mesh.lod_error));
+  mesh.mapping     = p;
+  mesh.mapping_size = (size_t)st.st_size;
+
+  return true;
+}
+
+bool MeshCache::save(const char *source,const Mesh &mesh) {
+  Source s;
+  if(!describe(source,s))
+    return false;
+
+  const uint64_t nv = (uint64_t)mesh.nb_vertices*3*sizeof(float);
+  const uint64_t nf = (uint64_t)mesh.nb_faces*3*sizeof(unsigned int);
+  const uint64_t nl = (uint64_t)mesh.nb_lod_faces*3*sizeof(unsigned int);
+
+  Header h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,MAGIC,sizeof(MAGIC));
+  h.version     = VERSION;
+  h.endianness  = ENDIANNESS;
+  h.sourceSize  = s.size;
+  h.sourceMtime = s.mtime;
+  h.sourceHash  = s.hash;
+  h.nbVertices  = mesh.nb_vertices;
+  h.nbFaces     = mesh.nb_faces;
+  memcpy(h.center,mesh.center,sizeof(h.center));
+  h.radius      = mesh.radius;
+  h.nbLods      = mesh.nb_lods;
+  h.nbLodFaces  = mesh.nb_lod_faces;
+  memcpy(h.lodFirst,mesh.lod_first,sizeof(h.lodFirst));
+  memcpy(h.lodSize,mesh.lod_size,sizeof(h.lodSize));
+  memcpy(h.lodError,mesh.lod_error,sizeof(h.lodError));
+  h.offsets[0]  = align(sizeof(Header));
+  h.offsets[1]  = align(h.offsets[0]+nv);
+  h.offsets[2]  = align(h.offsets[1]+nv);
+  h.offsets[3]  = align(h.offsets[2]+nv);
+  h.offsets[4]  = align(h.offsets[3]+nf);
+  h.fileSize    = h.offsets[4]+nl;
+
+  const void *blobs[5] = {mesh.vertices,mesh.normals,mesh.colors,mesh.faces,mesh.lod_faces};
+  const uint64_t sizes[5] = {nv,nv,nv,nf,nl};
+
+  return writeFileAtomic(path(source),[&](int fd) {
+      static const char zeros[BLOB_ALIGN] = {0};
+      bool ok = writeAll(fd,&h,sizeof(h));
+      uint64_t pos = sizeof(h);
+      for(int i=0;i<5 && ok;++i) {
+	ok = writeAll(fd,zeros,(size_t)(h.offsets[i]-pos)) && (sizes[i]==0 || writeAll(fd,blobs[i],(size_t)sizes[i]));
+	pos = h.offsets[i]+sizes[i];
+      }
+      return ok;
+    });
+}
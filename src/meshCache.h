@@ -0,0 +1,51 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdint.h>
+#include <string>
+
+#include "meshLoader.h"
+
+// Binary image of a loaded Mesh, written next to its source file
+// (<source>.mesh) so that the next runs map it instead of parsing the OFF
+// file and recomputing normals, colors, center, radius and levels of detail.
+//
+// Layout: a Header then the vertices, normals, colors (3 floats per
+// vertex), faces and lod faces (3 indices per triangle), each blob starting
+// on a BLOB_ALIGN boundary. The cache is only used if it was written from a
+// source of the same size, modification time and sampled content hash.
+class MeshCache {
+ public:
+  static const uint32_t VERSION    = 3;
+  static const uint32_t BLOB_ALIGN = 64;
+
+  struct Header {
+    char     magic[8];      // "SIMMESH"
+    uint32_t version;       // VERSION
+    uint32_t endianness;    // 0x01020304 as written by the machine
+    uint64_t sourceSize;
+    int64_t  sourceMtime;   // nanoseconds
+    uint64_t sourceHash;    // of the first and last 4 KB of the source
+    uint32_t nbVertices;
+    uint32_t nbFaces;
+    float    center[3];
+    float    radius;
+    uint32_t nbLods;
+    uint32_t nbLodFaces;
+    uint32_t lodFirst[Mesh::MAX_LODS];
+    uint32_t lodSize[Mesh::MAX_LODS];
+    float    lodError[Mesh::MAX_LODS];
+    uint64_t offsets[5];    // vertices, normals, colors, faces, lod faces
+    uint64_t fileSize;
+  };
+
+  static std::string path(const char *source);
+
+  // map a valid cache of source into mesh (false: no usable cache)
+  static bool load(const char *source,Mesh &mesh);
+
+  // write the cache of a mesh loaded from source (false on failure)
+  static bool save(const char *source,const Mesh &mesh);
+};
+
+#endif // MESH_CACHE_H
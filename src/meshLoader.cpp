@@ -1,14 +1,28 @@
 #include "meshLoader.h"
+#include "offReader.h"
+#include "meshCache.h"
+#include "meshNormals.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include <clocale>
+#include <algorithm>
+#include <vector>
+#include <sys/mman.h>
 
 unsigned int *Mesh::get_face(unsigned int i) {
   return &(faces[3*i]);
 }
 
+unsigned int *Mesh::get_lod_face(unsigned int lod,unsigned int i) {
+  const unsigned int t = lod_first[lod]+i;
+  return t<nb_faces ? &(faces[3*t]) : &(lod_faces[3*(t-nb_faces)]);
+}
+
 float *Mesh::get_vertex(unsigned int i) {
   return &(vertices[3*i]);
 }
@@ -21,79 +35,101 @@ float *Mesh::get_color(unsigned int i) {
   return &(colors[3*i]);
 }
 
+// simplified versions of the mesh, each about half the previous one, until
+// the simplifier gets stuck or the error becomes too large to be useful
+static void buildLods(Mesh &m) {
+  const unsigned int MIN_FACES = 32;
+  const float        MAX_ERROR = 0.25f; // of the radius
+
+  m.nb_lods      = 1;
+  m.lod_first[0] = 0;
+  m.lod_size[0]  = m.nb_faces;
+  m.lod_error[0] = 0.0f;
+  m.nb_lod_faces = 0;
+  m.lod_faces    = (unsigned int *)malloc(3*m.nb_faces*sizeof(unsigned int));
+  if(!m.lod_faces)
+    return;
+
+  // simplify writes up to 3*nb_faces indices before we know whether the
+  // level is kept: it works in a scratch buffer
+  std::vector<unsigned int> f(3*(size_t)m.nb_faces);
+  unsigned int capacity = m.nb_faces;
+
+  while(m.nb_lods<Mesh::MAX_LODS) {
+    const unsigned int previous = m.lod_size[m.nb_lods-1];
+    if(previous/2<MIN_FACES)
+      break;
+
+    // always from the full mesh: the errors do not add up
+    float e;
+    const unsigned int n = MeshSimplifier::simplify(m.vertices,m.nb_vertices,m.faces,m.nb_faces,
+						    &f[0],previous/2,MAX_ERROR*m.radius,&e);
+    if(n==0 || n>previous*4/5)
+      break;
+
+    if(m.nb_lod_faces+n>capacity) {
+      const unsigned int c = std::max(2*capacity,m.nb_lod_faces+n);
+      unsigned int *grown = (unsigned int *)realloc(m.lod_faces,3*(size_t)c*sizeof(unsigned int));
+      if(!grown)
+	break;
+      m.lod_faces = grown;
+      capacity    = c;
+    }
+
+    MeshOptimizer::optimizeFaces(m.vertices,m.nb_vertices,&f[0],n);
+    memcpy(m.lod_faces+3*m.nb_lod_faces,&f[0],3*(size_t)n*sizeof(unsigned int));
 
-Mesh::Mesh(char *filename) {
-  unsigned int tmp;
-  unsigned int i,j;
-  unsigned int *f;
-  float *nf;
-  float norm;
-  float *v1, *v2, *v3;
-  float v12[3];
-  float v13[3];
-  float *nv;
-  float *n;
-  FILE *file;
-  int   error;
+    m.lod_first[m.nb_lods] = m.nb_faces+m.nb_lod_faces;
+    m.lod_size [m.nb_lods] = n;
+    m.lod_error[m.nb_lods] = std::max(e,m.lod_error[m.nb_lods-1]);
+    m.nb_lod_faces += n;
+    m.nb_lods++;
+  }
+}
+
+Mesh::Mesh(char *filename,ThreadPool *pool) {
+  unsigned int i;
   float c[3] = {0.0,0.0,0.0};
   float r;
 
   setlocale(LC_ALL,"C");
 
-  if((file=fopen(filename,"r"))==NULL) {
-    printf("Unable to read %s\n",filename);
-  }
+  mapping      = NULL;
+  mapping_size = 0;
+
+  // binary image written by a previous run: nothing to compute
+  if(MeshCache::load(filename,*this))
+    return;
 
   // create mesh
-  vertices = NULL;
-  normals  = NULL;
-  colors   = NULL;
-  faces    = NULL;
-
-  error = fscanf(file,"OFF\n%d %d %d\n",&(nb_vertices),&(nb_faces),&tmp);
-  if(error==EOF) {
-    printf("Unable to read %s\n",filename);
+  OffData data;
+  if(!readOff(filename,data,error,pool)) {
+    // empty mesh, error tells why
+    nb_vertices = 0;
+    nb_faces    = 0;
+    vertices    = NULL;
+    normals     = NULL;
+    colors      = NULL;
+    faces       = NULL;
+    center[0] = center[1] = center[2] = 0.0f;
+    radius    = 0.0f;
+    nb_lods      = 0;
+    nb_lod_faces = 0;
+    lod_faces    = NULL;
+    return;
   }
 
-  //printf("Found %d vertices and %d faces",nb_vertices,nb_faces);
-
-  vertices = (float *)malloc(3*nb_vertices*sizeof(float));
-  normals  = (float *)malloc(3*nb_vertices*sizeof(float));
-  colors   = (float *)malloc(3*nb_vertices*sizeof(float));
-  faces    = (unsigned int *)malloc(3*nb_faces*sizeof(unsigned int));
-
-  // reading vertices
-  j = 0;
-  for(i=0;i<nb_vertices;++i) {
-    error = fscanf(file,"%f %f %f\n",&(vertices[j]),&(vertices[j+1]),&(vertices[j+2]));
-    if(error==EOF) {
-      printf("Unable to read vertices of %s\n",filename);
-      // mesh_delete(mesh);
-      // return NULL;
-    }
-
-    j += 3;
-  }
+  nb_vertices = data.nbVertices;
+  nb_faces    = data.nbFaces;
+  vertices    = data.vertices;
+  faces       = data.faces;
+  normals     = (float *)malloc(3*nb_vertices*sizeof(float));
+  colors      = (float *)malloc(3*nb_vertices*sizeof(float));
 
-  // reading faces
-  j = 0;
-  for(i=0;i<nb_faces;++i) {
-    error = fscanf(file,"%d %d %d %d\n",&tmp,&(faces[j]),&(faces[j+1]),&(faces[j+2]));
-    if(error==EOF) {
-      printf("Unable to read faces of %s\n",filename);
-      // mesh_delete(mesh);
-      // return NULL;
-    }
-    
-    if(tmp!=3) {
-      printf("Error : face %d is not a triangle (%d polygonal face!)\n",i/3,tmp);
-      // mesh_delete(mesh);
-      // return NULL;
-    }
-    j += 3;
-  }
-  
-  fclose(file); 
+  // GPU friendly order of the faces, then of the vertices (done once, the
+  // cache keeps it)
+  MeshOptimizer::optimizeFaces(vertices,nb_vertices,faces,nb_faces);
+  MeshOptimizer::optimizeVertexFetch(vertices,nb_vertices,faces,nb_faces);
 
   // computing center
   for(i=0;i<nb_vertices*3;i+=3) {
@@ -116,84 +152,27 @@ Mesh::Mesh(char *filename) {
     radius = r>radius ? r : radius;
   }
 
-  // computing normals per faces
-  nf = (float *)malloc(3*nb_faces*sizeof(float));
-  for(i=0;i<nb_faces;++i) {
-    f = get_face(i);
-    
-    // the three vertices of the current face
-    v1 = get_vertex(f[0]);
-    v2 = get_vertex(f[1]);
-    v3 = get_vertex(f[2]);
-
-    // the two vectors of the current face
-    v12[0] = v2[0]-v1[0];
-    v12[1] = v2[1]-v1[1];
-    v12[2] = v2[2]-v1[2];
-
-    v13[0] = v3[0]-v1[0];
-    v13[1] = v3[1]-v1[1];
-    v13[2] = v3[2]-v1[2];
-
-    // cross product
-    nf[3*i  ] = v12[1]*v13[2] - v12[2]*v13[1];
-    nf[3*i+1] = v12[2]*v13[0] - v12[0]*v13[2];
-    nf[3*i+2] = v12[0]*v13[1] - v12[1]*v13[0];
-
-    // normalization
-    norm = sqrt(nf[3*i]*nf[3*i]+nf[3*i+1]*nf[3*i+1]+nf[3*i+2]*nf[3*i+2]);
-    nf[3*i  ] /= norm;
-    nf[3*i+1] /= norm;
-    nf[3*i+2] /= norm;
-  }
-
-  // computing normals per vertex
-  nv = (float *)malloc(nb_vertices*sizeof(float));
-  for(i=0;i<nb_vertices;++i) {
-    // initialization
-    normals[3*i  ] = 0.0;
-    normals[3*i+1] = 0.0;
-    normals[3*i+2] = 0.0;
-    nv[i] = 0.0;
-  }
-  for(i=0;i<nb_faces;++i) {
-    // face normals average  
-    f = get_face(i);
-    n = &(nf[3*i]);
-
-    normals[3*f[0]  ] += nf[3*i  ];
-    normals[3*f[0]+1] += nf[3*i+1];
-    normals[3*f[0]+2] += nf[3*i+2];
-    nv[f[0]] ++;
-
-    normals[3*f[1]  ] += nf[3*i  ];
-    normals[3*f[1]+1] += nf[3*i+1];
-    normals[3*f[1]+2] += nf[3*i+2];
-    nv[f[1]] ++;
-
-    normals[3*f[2]  ] += nf[3*i  ];
-    normals[3*f[2]+1] += nf[3*i+1];
-    normals[3*f[2]+2] += nf[3*i+2];
-    nv[f[2]] ++;
-  }
-  for(i=0;i<nb_vertices;++i) {
-    // normalization
-    normals[3*i  ] /= nv[i];
-    normals[3*i+1] /= nv[i];
-    normals[3*i+2] /= nv[i];
-  }
-
-  free(nf);
-  free(nv);
+  // computing normals per vertex (mean of the face normals)
+  MeshNormals::vertexNormals(vertices,nb_vertices,faces,nb_faces,normals,MeshNormals::UNIFORM,pool);
 
   // computing colors as normals 
   for(i=0;i<3*nb_vertices;++i) {
     colors[i] = (normals[i]+1.0)/2.0;
   }
-  
+
+  // coarser versions for the distant instances
+  buildLods(*this);
+
+  // next runs will map it
+  MeshCache::save(filename,*this);
 }
 
 Mesh::~Mesh() {
+  if(mapping!=NULL) {
+    munmap(mapping,mapping_size);
+    return;
+  }
+
   if(normals!=NULL)
     free(normals);
   
@@ -205,4 +184,7 @@ Mesh::~Mesh() {
   
   if(faces!=NULL)
     free(faces);
+
+  if(lod_faces!=NULL)
+    free(lod_faces);
 }
@@ -1,12 +1,19 @@
 #ifndef MESH_LOADER_H
 #define MESH_LOADER_H
 
+#include <string>
+
+#include "threadPool.h"
+
 class Mesh {
  public:
-  Mesh(char *filename);
+  // the file is parsed by the pool if given (large models), unless a
+  // binary cache of it exists (written after the first parse)
+  Mesh(char *filename,ThreadPool *pool=NULL);
   ~Mesh();
 
   unsigned int *get_face(unsigned int i);
+  unsigned int *get_lod_face(unsigned int lod,unsigned int i);
   float        *get_vertex(unsigned int i);
   float        *get_normal(unsigned int i);
   float        *get_color(unsigned int i);
@@ -24,6 +31,25 @@ class Mesh {
   // info
   float         center[3];
   float         radius;
+
+  // levels of detail (see MeshSimplifier), sharing the vertices: lod i is
+  // lod_size[i] triangles from triangle lod_first[i] of faces followed by
+  // lod_faces (lod 0 is faces), at lod_error[i] from the full mesh
+  static const unsigned int MAX_LODS = 8;
+  unsigned int  nb_lods;
+  unsigned int  lod_first[MAX_LODS];
+  unsigned int  lod_size[MAX_LODS];
+  float         lod_error[MAX_LODS];
+  unsigned int  nb_lod_faces;
+  unsigned int *lod_faces;    // triangles of the lods 1 to nb_lods-1
+
+  // why the file could not be loaded (empty mesh), empty on success
+  std::string   error;
+
+  // arrays mapped from the binary cache (see MeshCache) instead of malloc
+  void         *mapping;
+  size_t        mapping_size;
+  inline bool   loaded() const {return error.empty();}
 };
 
 #endif // MESH_LOADER_H
@@ -0,0 +1,203 @@
+#include "meshNormals.h"
+#include "simd.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+using namespace simd;
+
+namespace {
+
+// faces per task
+const unsigned int GRAIN = 16384;
+
+// unit normals (n, 3 floats per face) and norms of the cross products
+// (length, 1 float per face) of faces [first,last), V::width at a time
+template<class V> void faceNormalsT(const float *vertices,const unsigned int *faces,
+				    unsigned int first,unsigned int last,float *n,float *length) {
+  const unsigned int W = V::width;
+  float p[9][W];
+  float out[4][W];
+
+  for(unsigned int i=first;i+W<=last;i+=W) {
+    // gather the 3 corners of W faces
+    for(unsigned int j=0;j<W;++j) {
+      const unsigned int *f = faces+3*(i+j);
+      for(unsigned int k=0;k<3;++k) {
+	const float *v = vertices+3*f[k];
+	p[3*k  ][j] = v[0];
+	p[3*k+1][j] = v[1];
+	p[3*k+2][j] = v[2];
+      }
+    }
+
+    const V x1 = V::load(p[0]),y1 = V::load(p[1]),z1 = V::load(p[2]);
+    const V x12 = V::load(p[3])-x1,y12 = V::load(p[4])-y1,z12 = V::load(p[5])-z1;
+    const V x13 = V::load(p[6])-x1,y13 = V::load(p[7])-y1,z13 = V::load(p[8])-z1;
+
+    const V cx = y12*z13-z12*y13;
+    const V cy = z12*x13-x12*z13;
+    const V cz = x12*y13-y12*x13;
+    const V l  = vsqrt(cx*cx+cy*cy+cz*cz);
+
+    // degenerated faces get a null normal
+    vselectLess(V(0.0f),l,cx/l,V(0.0f)).store(out[0]);
+    vselectLess(V(0.0f),l,cy/l,V(0.0f)).store(out[1]);
+    vselectLess(V(0.0f),l,cz/l,V(0.0f)).store(out[2]);
+    l.store(out[3]);
+
+    for(unsigned int j=0;j<W;++j) {
+      n[3*(i+j)  ] = out[0][j];
+      n[3*(i+j)+1] = out[1][j];
+      n[3*(i+j)+2] = out[2][j];
+      if(length)
+	length[i+j] = out[3][j];
+    }
+  }
+}
+
+void faceNormalsRange(const float *vertices,const unsigned int *faces,
+		      unsigned int first,unsigned int last,float *n,float *length) {
+  const unsigned int nbSimd = first+(last-first)/FN::width*FN::width;
+  faceNormalsT<FN>(vertices,faces,first,nbSimd,n,length);
+  faceNormalsT<F1>(vertices,faces,nbSimd,last,n,length);
+}
+
+// angle of the triangle (a,b,c) at a
+float angle(const float *a,const float *b,const float *c) {
+  const float e1[3] = {b[0]-a[0],b[1]-a[1],b[2]-a[2]};
+  const float e2[3] = {c[0]-a[0],c[1]-a[1],c[2]-a[2]};
+  const float cx = e1[1]*e2[2]-e1[2]*e2[1];
+  const float cy = e1[2]*e2[0]-e1[0]*e2[2];
+  const float cz = e1[0]*e2[1]-e1[1]*e2[0];
+  return atan2f(sqrtf(cx*cx+cy*cy+cz*cz),e1[0]*e2[0]+e1[1]*e2[1]+e1[2]*e2[2]);
+}
+
+} // namespace
+
+void MeshNormals::faceNormals(const float *vertices,const unsigned int *faces,unsigned int nbFaces,
+			      float *normals,ThreadPool *pool) {
+  forRange(pool,nbFaces,GRAIN,[&](unsigned int first,unsigned int last) {
+      faceNormalsRange(vertices,faces,first,last,normals,NULL);
+    });
+}
+
+void MeshNormals::vertexNormals(const float *vertices,unsigned int nbVertices,
+				const unsigned int *faces,unsigned int nbFaces,
+				float *normals,Weighting weighting,ThreadPool *pool) {
+  // 1. unit normal and weight of each corner of each face
+  vector<float> faceN(3*(size_t)nbFaces);
+  vector<float> weights(weighting==UNIFORM ? 0 : 3*(size_t)nbFaces);
+  vector<float> length(weighting==AREA ? nbFaces : 0);
+
+  forRange(pool,nbFaces,GRAIN,[&](unsigned int first,unsigned int last) {
+      faceNormalsRange(vertices,faces,first,last,&faceN[0],weighting==AREA ? &length[0] : NULL);
+
+      if(weighting==UNIFORM)
+	return;
+
+      for(unsigned int i=first;i<last;++i) {
+	const unsigned int *f = faces+3*i;
+	for(unsigned int k=0;k<3;++k) {
+	  weights[3*(size_t)i+k] = weighting==AREA ? length[i] :
+	    angle(vertices+3*f[k],vertices+3*f[(k+1)%3],vertices+3*f[(k+2)%3]);
+	}
+      }
+    });
+
+  // 2. corners sorted by the part of the vertices owning them (counting
+  // sort, face order kept within each part): each task then sums only its
+  // own corners, the work stays O(faces) whatever the number of threads
+  const unsigned int nbParts   = pool ? pool->nbThreads() : 1;
+  const unsigned int partSize  = max(1u,(nbVertices+nbParts-1)/nbParts);
+  const unsigned int partFaces = (nbFaces+nbParts-1)/nbParts;
+
+  // count[b*nbParts+p]: corners of the faces of block b owned by part p
+  vector<unsigned int> count((size_t)nbParts*nbParts,0);
+  unique_ptr<unsigned int[]> corners(new unsigned int[nbParts>1 ? 3*(size_t)nbFaces : 0]);
+  vector<unsigned int> partFirst(nbParts+1,0);
+
+  if(nbParts>1) {
+    forRange(pool,nbParts,1,[&](unsigned int firstBlock,unsigned int lastBlock) {
+	for(unsigned int b=firstBlock;b<lastBlock;++b) {
+	  unsigned int *n = &count[(size_t)b*nbParts];
+	  const unsigned int c1 = 3*min(nbFaces,(b+1)*partFaces);
+	  for(unsigned int c=3*min(nbFaces,b*partFaces);c<c1;++c)
+	    n[faces[c]/partSize]++;
+	}
+      });
+
+    // offsets, part by part then block by block
+    unsigned int o = 0;
+    for(unsigned int p=0;p<nbParts;++p) {
+      partFirst[p] = o;
+      for(unsigned int b=0;b<nbParts;++b) {
+	const unsigned int n = count[(size_t)b*nbParts+p];
+	count[(size_t)b*nbParts+p] = o;
+	o += n;
+      }
+    }
+    partFirst[nbParts] = o;
+
+    forRange(pool,nbParts,1,[&](unsigned int firstBlock,unsigned int lastBlock) {
+	for(unsigned int b=firstBlock;b<lastBlock;++b) {
+	  unsigned int *pos = &count[(size_t)b*nbParts];
+	  const unsigned int c1 = 3*min(nbFaces,(b+1)*partFaces);
+	  for(unsigned int c=3*min(nbFaces,b*partFaces);c<c1;++c)
+	    corners[pos[faces[c]/partSize]++] = c;
+	}
+      });
+  } else {
+    partFirst[1] = 3*nbFaces;
+  }
+
+  // 3. sums, each part of the vertices over its own corners
+  forRange(pool,nbParts,1,[&](unsigned int firstPart,unsigned int lastPart) {
+      const unsigned int v0 = min(nbVertices,firstPart*partSize);
+      const unsigned int v1 = min(nbVertices,lastPart*partSize);
+      if(v0>=v1)
+	return;
+
+      vector<float> count(weighting==UNIFORM ? v1-v0 : 0,0.0f);
+      memset(normals+3*(size_t)v0,0,3*(size_t)(v1-v0)*sizeof(float));
+
+      for(unsigned int i=partFirst[firstPart];i<partFirst[lastPart];++i) {
+	// corner c of face c/3
+	const unsigned int c = nbParts>1 ? corners[i] : i;
+	const float *n = &faceN[3*(size_t)(c/3)];
+
+	float *s = normals+3*(size_t)faces[c];
+	if(weighting==UNIFORM) {
+	  s[0] += n[0];
+	  s[1] += n[1];
+	  s[2] += n[2];
+	  count[faces[c]-v0]++;
+	} else {
+	  const float w = weights[c];
+	  s[0] += w*n[0];
+	  s[1] += w*n[1];
+	  s[2] += w*n[2];
+	}
+      }
+
+      // 4. mean (uniform) or unit length (weighted)
+      for(unsigned int v=v0;v<v1;++v) {
+	float *s = normals+3*(size_t)v;
+	float d;
+	if(weighting==UNIFORM)
+	  d = count[v-v0];
+	else
+	  d = sqrtf(s[0]*s[0]+s[1]*s[1]+s[2]*s[2]);
+
+	if(d>0.0f) {
+	  s[0] /= d;
+	  s[1] /= d;
+	  s[2] /= d;
+	}
+      }
+    });
+}
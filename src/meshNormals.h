@@ -0,0 +1,30 @@
+#ifndef MESH_NORMALS_H
+#define MESH_NORMALS_H
+
+#include "threadPool.h"
+
+// Normals of an indexed triangle mesh (3 floats per vertex, 3 indices per
+// face). Face normals are computed with the SIMD types of simd.h, vertex
+// normals are accumulated without conflicts: with a pool, each task owns
+// a range of vertices and the corners are counting sorted by owner first,
+// so a task only visits its own corners and the sums are still done in
+// face order whatever the number of threads.
+class MeshNormals {
+ public:
+  enum Weighting {
+    UNIFORM, // mean of the unit face normals (not renormalized, as Mesh did)
+    AREA,    // face normals weighted by the area of the faces
+    ANGLE    // face normals weighted by the angle of the face at the vertex
+  };
+
+  // unit normal of each face (0 for degenerated faces)
+  static void faceNormals(const float *vertices,const unsigned int *faces,unsigned int nbFaces,
+			  float *normals,ThreadPool *pool=NULL);
+
+  // normal of each vertex (0 for unused vertices)
+  static void vertexNormals(const float *vertices,unsigned int nbVertices,
+			    const unsigned int *faces,unsigned int nbFaces,
+			    float *normals,Weighting weighting=UNIFORM,ThreadPool *pool=NULL);
+};
+
+#endif // MESH_NORMALS_H
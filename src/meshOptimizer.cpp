@@ -0,0 +1,262 @@
+#include "meshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// smallest cluster worth sorting on its own (in triangles)
+const unsigned int MIN_CLUSTER = 64;
+
+// triangles around each vertex (compressed rows)
+struct Adjacency {
+  vector<unsigned int> first; // nbVertices+1
+  vector<unsigned int> faces;
+
+  Adjacency(const unsigned int *f,unsigned int nbVertices,unsigned int nbFaces)
+    : first(nbVertices+1,0),faces(3*(size_t)nbFaces) {
+    for(size_t i=0;i<3*(size_t)nbFaces;++i)
+      first[f[i]+1]++;
+    for(unsigned int v=0;v<nbVertices;++v)
+      first[v+1] += first[v];
+
+    vector<unsigned int> pos(first.begin(),first.end()-1);
+    for(unsigned int t=0;t<nbFaces;++t)
+      for(unsigned int k=0;k<3;++k)
+	faces[pos[f[3*t+k]]++] = t;
+  }
+};
+
+// Tipsify: emit the triangles around a fanning vertex, then choose the
+// next one among their vertices (still in cache, with live triangles), or
+// go back to a dead end. Fills order with the triangles and hard with the
+// positions where the cache is left (new clusters).
+void tipsify(const unsigned int *f,unsigned int nbVertices,unsigned int nbFaces,unsigned int k,
+	     vector<unsigned int> &order,vector<unsigned int> &hard) {
+  const Adjacency adj(f,nbVertices,nbFaces);
+
+  vector<unsigned int> live(nbVertices);
+  for(unsigned int v=0;v<nbVertices;++v)
+    live[v] = adj.first[v+1]-adj.first[v];
+
+  vector<unsigned int> stamp(nbVertices,0);   // time of entry in the cache
+  vector<char>         emitted(nbFaces,0);
+  vector<unsigned int> deadEnd;
+  vector<unsigned int> candidates;
+  unsigned int time   = k+1;
+  unsigned int cursor = 0;
+
+  order.clear();
+  hard.clear();
+  order.reserve(nbFaces);
+
+  int fan = -1;
+  while(cursor<nbVertices && live[cursor]==0) cursor++;
+  if(cursor<nbVertices) {
+    fan = (int)cursor;
+    hard.push_back(0);
+  }
+
+  while(fan>=0) {
+    candidates.clear();
+
+    for(unsigned int a=adj.first[fan];a<adj.first[fan+1];++a) {
+      const unsigned int t = adj.faces[a];
+      if(emitted[t])
+	continue;
+
+      for(unsigned int j=0;j<3;++j) {
+	const unsigned int v = f[3*t+j];
+	deadEnd.push_back(v);
+	candidates.push_back(v);
+	live[v]--;
+	if(time-stamp[v]>k)
+	  stamp[v] = time++;
+      }
+      emitted[t] = 1;
+      order.push_back(t);
+    }
+
+    // best candidate: in cache after emitting its fan, the oldest one
+    int next = -1;
+    int best = -1;
+    for(unsigned int c=0;c<candidates.size();++c) {
+      const unsigned int v = candidates[c];
+      if(live[v]==0)
+	continue;
+
+      int priority = 0;
+      if(time-stamp[v]+2*live[v]<=k)
+	priority = (int)(time-stamp[v]);
+      if(priority>best) {
+	best = priority;
+	next = (int)v;
+      }
+    }
+
+    if(next<0) {
+      // dead end: recent vertices first, then the next unfinished one
+      while(!deadEnd.empty() && next<0) {
+	const unsigned int d = deadEnd.back();
+	deadEnd.pop_back();
+	if(live[d]>0)
+	  next = (int)d;
+      }
+      while(next<0 && cursor<nbVertices) {
+	if(live[cursor]>0)
+	  next = (int)cursor;
+	else
+	  cursor++;
+      }
+      if(next>=0 && order.size()<nbFaces)
+	hard.push_back((unsigned int)order.size());
+    }
+
+    fan = next;
+  }
+}
+
+// number of vertices of triangle t not in the FIFO cache (then added)
+unsigned int misses(const unsigned int *t,vector<unsigned int> &entry,unsigned int &time,unsigned int size) {
+  unsigned int n = 0;
+  for(unsigned int j=0;j<3;++j) {
+    const unsigned int v = t[j];
+    if(entry[v]==0 || time-entry[v]>=size) {
+      entry[v] = ++time;
+      n++;
+    }
+  }
+  return n;
+}
+
+struct Cluster {
+  unsigned int first; // in the tipsify order
+  unsigned int last;
+  float        sort;  // occlusion potential
+};
+
+bool drawnBefore(const Cluster &a,const Cluster &b) {
+  return a.sort>b.sort;
+}
+
+} // namespace
+
+void MeshOptimizer::optimizeFaces(const float *vertices,unsigned int nbVertices,
+				  unsigned int *faces,unsigned int nbFaces,
+				  unsigned int cacheSize) {
+  if(nbFaces==0)
+    return;
+
+  vector<unsigned int> order,hard;
+  tipsify(faces,nbVertices,nbFaces,cacheSize,order,hard);
+
+  // clusters: hard boundaries, and soft ones where 3 vertices are missed
+  // anyway once the cluster is big enough
+  vector<Cluster> clusters;
+  vector<unsigned int> entry(nbVertices,0);
+  unsigned int time = 0;
+  unsigned int h = 0;
+  Cluster c;
+  c.first = 0;
+
+  for(unsigned int i=0;i<nbFaces;++i) {
+    const bool boundary = h<hard.size() && hard[h]==i;
+    if(boundary) h++;
+
+    const unsigned int m = misses(faces+3*order[i],entry,time,cacheSize);
+    if(i>c.first && (boundary || (m==3 && i-c.first>=MIN_CLUSTER))) {
+      c.last = i;
+      clusters.push_back(c);
+      c.first = i;
+    }
+  }
+  c.last = nbFaces;
+  clusters.push_back(c);
+
+  // occlusion potential: how much the cluster faces away from the center
+  double center[3] = {0.0,0.0,0.0};
+  for(unsigned int v=0;v<nbVertices;++v)
+    for(unsigned int j=0;j<3;++j)
+      center[j] += vertices[3*v+j];
+  for(unsigned int j=0;j<3;++j)
+    center[j] /= (double)max(1u,nbVertices);
+
+  for(unsigned int k=0;k<clusters.size();++k) {
+    double p[3] = {0.0,0.0,0.0};
+    double n[3] = {0.0,0.0,0.0};
+    double area = 0.0;
+
+    for(unsigned int i=clusters[k].first;i<clusters[k].last;++i) {
+      const unsigned int *t = faces+3*order[i];
+      const float *a = vertices+3*t[0];
+      const float *b = vertices+3*t[1];
+      const float *d = vertices+3*t[2];
+      const double e1[3] = {b[0]-a[0],b[1]-a[1],b[2]-a[2]};
+      const double e2[3] = {d[0]-a[0],d[1]-a[1],d[2]-a[2]};
+      const double cr[3] = {e1[1]*e2[2]-e1[2]*e2[1],e1[2]*e2[0]-e1[0]*e2[2],e1[0]*e2[1]-e1[1]*e2[0]};
+      const double w = sqrt(cr[0]*cr[0]+cr[1]*cr[1]+cr[2]*cr[2]);
+
+      for(unsigned int j=0;j<3;++j) {
+	p[j] += w*(a[j]+b[j]+d[j])/3.0;
+	n[j] += cr[j];
+      }
+      area += w;
+    }
+
+    const double ln = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    float s = 0.0f;
+    if(area>0.0 && ln>0.0)
+      for(unsigned int j=0;j<3;++j)
+	s += (float)((p[j]/area-center[j])*n[j]/ln);
+    clusters[k].sort = s;
+  }
+
+  stable_sort(clusters.begin(),clusters.end(),drawnBefore);
+
+  vector<unsigned int> result;
+  result.reserve(3*(size_t)nbFaces);
+  for(unsigned int k=0;k<clusters.size();++k)
+    for(unsigned int i=clusters[k].first;i<clusters[k].last;++i)
+      result.insert(result.end(),faces+3*order[i],faces+3*order[i]+3);
+
+  memcpy(faces,&result[0],result.size()*sizeof(unsigned int));
+}
+
+void MeshOptimizer::optimizeVertexFetch(float *vertices,unsigned int nbVertices,
+					unsigned int *faces,unsigned int nbFaces) {
+  const unsigned int NONE = 0xffffffffu;
+  vector<unsigned int> remap(nbVertices,NONE);
+  unsigned int next = 0;
+
+  for(size_t i=0;i<3*(size_t)nbFaces;++i) {
+    unsigned int &r = remap[faces[i]];
+    if(r==NONE)
+      r = next++;
+    faces[i] = r;
+  }
+  for(unsigned int v=0;v<nbVertices;++v)
+    if(remap[v]==NONE)
+      remap[v] = next++;
+
+  vector<float> moved(3*(size_t)nbVertices);
+  for(unsigned int v=0;v<nbVertices;++v)
+    memcpy(&moved[3*(size_t)remap[v]],vertices+3*(size_t)v,3*sizeof(float));
+  if(nbVertices)
+    memcpy(vertices,&moved[0],moved.size()*sizeof(float));
+}
+
+float MeshOptimizer::acmr(const unsigned int *faces,unsigned int nbFaces,
+			  unsigned int nbVertices,unsigned int cacheSize) {
+  vector<unsigned int> entry(nbVertices,0);
+  unsigned int time = 0;
+  size_t n = 0;
+
+  for(unsigned int i=0;i<nbFaces;++i)
+    n += misses(faces+3*i,entry,time,cacheSize);
+
+  return nbFaces ? (float)n/(float)nbFaces : 0.0f;
+}
@@ -0,0 +1,28 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+// Reordering of an indexed triangle mesh for the GPU, done once at load
+// time (the result goes into the binary cache of Mesh):
+// - faces in Tipsify order (Sander et al. 2007) for the post-transform
+//   vertex cache, cut in clusters at the points where the cache restarts,
+// - clusters sorted so that the ones most likely to hide the others
+//   (facing away from the mesh center) are drawn first, against overdraw,
+// - vertices renumbered in order of first use, for the vertex fetch.
+class MeshOptimizer {
+ public:
+  // face order: tipsify then overdraw sort of the clusters
+  static void optimizeFaces(const float *vertices,unsigned int nbVertices,
+			    unsigned int *faces,unsigned int nbFaces,
+			    unsigned int cacheSize=16);
+
+  // renumber the vertices by first use in faces: vertices (3 floats each)
+  // are permuted in place, unused ones go to the end
+  static void optimizeVertexFetch(float *vertices,unsigned int nbVertices,
+				  unsigned int *faces,unsigned int nbFaces);
+
+  // average number of vertex shader runs per triangle with a FIFO cache
+  static float acmr(const unsigned int *faces,unsigned int nbFaces,
+		    unsigned int nbVertices,unsigned int cacheSize=16);
+};
+
+#endif // MESH_OPTIMIZER_H
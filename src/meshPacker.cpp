@@ -0,0 +1,66 @@
+#include "meshPacker.h"
+
+#include <math.h>
+
+// [-1,1] to signed normalized 16 bits (GL: c/32767)
+static inline int16_t snorm16(float v) {
+  v = v<-1.0f ? -1.0f : (v>1.0f ? 1.0f : v);
+  return (int16_t)lrintf(v*32767.0f);
+}
+
+static inline float unsnorm16(int16_t c) {
+  const float v = (float)c/32767.0f;
+  return v<-1.0f ? -1.0f : v;
+}
+
+void MeshPacker::octEncode(const float *n,int16_t *e) {
+  const float l = fabsf(n[0])+fabsf(n[1])+fabsf(n[2]);
+  if(l==0.0f) {
+    e[0] = e[1] = 0;
+    return;
+  }
+
+  // on the octahedron |x|+|y|+|z|=1, the lower half folded over the upper
+  float x = n[0]/l;
+  float y = n[1]/l;
+  if(n[2]<0.0f) {
+    const float fx = (1.0f-fabsf(y))*(x>=0.0f ? 1.0f : -1.0f);
+    const float fy = (1.0f-fabsf(x))*(y>=0.0f ? 1.0f : -1.0f);
+    x = fx;
+    y = fy;
+  }
+
+  e[0] = snorm16(x);
+  e[1] = snorm16(y);
+}
+
+void MeshPacker::octDecode(const int16_t *e,float *n) {
+  // same as octDecode in shaders/cloud.vert
+  float x = unsnorm16(e[0]);
+  float y = unsnorm16(e[1]);
+  const float z = 1.0f-fabsf(x)-fabsf(y);
+  const float t = z<0.0f ? -z : 0.0f;
+  x += x>=0.0f ? -t : t;
+  y += y>=0.0f ? -t : t;
+
+  const float l = sqrtf(x*x+y*y+z*z);
+  n[0] = x/l;
+  n[1] = y/l;
+  n[2] = z/l;
+}
+
+void MeshPacker::pack(const float *vertices,const float *normals,unsigned int nbVertices,
+		      const float center[3],float radius,PackedVertex *packed) {
+  const float s = radius>0.0f ? 1.0f/radius : 0.0f;
+
+  for(unsigned int i=0;i<nbVertices;++i) {
+    const float *v = vertices+3*(size_t)i;
+    PackedVertex &p = packed[i];
+
+    for(unsigned int j=0;j<3;++j)
+      p.position[j] = snorm16((v[j]-center[j])*s);
+    p.position[3] = 0;
+
+    octEncode(normals+3*(size_t)i,p.normal);
+  }
+}
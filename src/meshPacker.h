@@ -0,0 +1,27 @@
+#ifndef MESH_PACKER_H
+#define MESH_PACKER_H
+
+#include <stdint.h>
+
+// Compact vertex for the GPU: 12 bytes instead of the 24 of the float
+// position and normal buffers.
+// - position: signed normalized 16 bits relative to the bounding sphere of
+//   the mesh (p = center+radius*position), w unused (4 bytes alignment)
+// - normal: octahedral encoding in 2 signed normalized 16 bits
+struct PackedVertex {
+  int16_t position[4];
+  int16_t normal[2];
+};
+
+class MeshPacker {
+ public:
+  // interleaved vertices (3 floats per position and normal) into packed
+  static void pack(const float *vertices,const float *normals,unsigned int nbVertices,
+		   const float center[3],float radius,PackedVertex *packed);
+
+  // octahedral encoding of a unit vector (zero gives +z), and its inverse
+  static void octEncode(const float *n,int16_t *e);
+  static void octDecode(const int16_t *e,float *n);
+};
+
+#endif // MESH_PACKER_H
@@ -0,0 +1,294 @@
+#include "meshSimplifier.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// boundary planes count much more than the faces: the silhouette of the
+// open parts of the mesh is kept
+const double BOUNDARY_WEIGHT = 10.0;
+
+// squared cosine of the largest rotation of a triangle by a collapse
+// (60 degrees): above, the triangle folds over its neighbours
+const double MAX_TURN_COS2 = 0.25;
+
+// symmetric 4x4 matrix of the sum of the squared distances to planes
+// (a,b,c,d), weighted by the area of their faces
+struct Quadric {
+  double a2,ab,ac,ad,b2,bc,bd,c2,cd,d2;
+  double w;
+
+  Quadric() : a2(0),ab(0),ac(0),ad(0),b2(0),bc(0),bd(0),c2(0),cd(0),d2(0),w(0) {}
+
+  void add(double a,double b,double c,double d,double weight) {
+    a2 += weight*a*a; ab += weight*a*b; ac += weight*a*c; ad += weight*a*d;
+    b2 += weight*b*b; bc += weight*b*c; bd += weight*b*d;
+    c2 += weight*c*c; cd += weight*c*d;
+    d2 += weight*d*d;
+    w  += weight;
+  }
+
+  void add(const Quadric &q) {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+    b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd;
+    d2 += q.d2;
+    w  += q.w;
+  }
+
+  // mean squared distance of p to the planes
+  double error(const float *p) const {
+    const double x = p[0],y = p[1],z = p[2];
+    const double e =
+      x*(a2*x+2.0*(ab*y+ac*z+ad)) +
+      y*(b2*y+2.0*(bc*z+bd)) +
+      z*(c2*z+2.0*cd) + d2;
+    return w>0.0 ? fabs(e)/w : 0.0;
+  }
+};
+
+struct Collapse {
+  unsigned int from;
+  unsigned int to;
+  double       cost;
+};
+
+bool cheaper(const Collapse &a,const Collapse &b) {
+  return a.cost<b.cost;
+}
+
+// edges (smaller index first) as sortable keys
+inline uint64_t edgeKey(unsigned int a,unsigned int b) {
+  return a<b ? ((uint64_t)a<<32)|b : ((uint64_t)b<<32)|a;
+}
+
+inline void cross(const double *u,const double *v,double *r) {
+  r[0] = u[1]*v[2]-u[2]*v[1];
+  r[1] = u[2]*v[0]-u[0]*v[2];
+  r[2] = u[0]*v[1]-u[1]*v[0];
+}
+
+inline void normal(const float *a,const float *b,const float *c,double *n) {
+  const double e1[3] = {(double)b[0]-a[0],(double)b[1]-a[1],(double)b[2]-a[2]};
+  const double e2[3] = {(double)c[0]-a[0],(double)c[1]-a[1],(double)c[2]-a[2]};
+  cross(e1,e2,n);
+}
+
+// edges with their number of triangles, sorted
+void countEdges(const vector<unsigned int> &tris,vector<uint64_t> &edges,vector<unsigned int> &counts) {
+  vector<uint64_t> all;
+  all.reserve(tris.size());
+  for(size_t t=0;t<tris.size();t+=3)
+    for(unsigned int k=0;k<3;++k)
+      all.push_back(edgeKey(tris[t+k],tris[t+(k+1)%3]));
+  sort(all.begin(),all.end());
+
+  edges.clear();
+  counts.clear();
+  for(size_t i=0;i<all.size();++i) {
+    if(edges.empty() || edges.back()!=all[i]) {
+      edges.push_back(all[i]);
+      counts.push_back(0);
+    }
+    counts.back()++;
+  }
+}
+
+inline bool isBoundary(const vector<uint64_t> &edges,const vector<unsigned int> &counts,uint64_t key) {
+  const vector<uint64_t>::const_iterator i = lower_bound(edges.begin(),edges.end(),key);
+  return i!=edges.end() && *i==key && counts[i-edges.begin()]==1;
+}
+
+// no triangle around from turns over when from moves onto to
+bool keepsOrientation(const float *vertices,const vector<unsigned int> &tris,
+		      const vector<unsigned int> &first,const vector<unsigned int> &around,
+		      unsigned int from,unsigned int to) {
+  const float *p = vertices+3*(size_t)to;
+
+  for(unsigned int a=first[from];a<first[from+1];++a) {
+    const unsigned int *t = &tris[3*(size_t)around[a]];
+    if(t[0]==to || t[1]==to || t[2]==to)
+      continue; // collapsed with the edge
+
+    const float *v[3];
+    for(unsigned int k=0;k<3;++k)
+      v[k] = vertices+3*(size_t)t[k];
+
+    double before[3],after[3];
+    normal(v[0],v[1],v[2],before);
+    for(unsigned int k=0;k<3;++k)
+      if(t[k]==from) v[k] = p;
+    normal(v[0],v[1],v[2],after);
+
+    const double d  = before[0]*after[0]+before[1]*after[1]+before[2]*after[2];
+    const double lb = before[0]*before[0]+before[1]*before[1]+before[2]*before[2];
+    const double la = after[0]*after[0]+after[1]*after[1]+after[2]*after[2];
+    if(lb==0.0)
+      continue; // already degenerate
+    if(d<=0.0 || d*d<MAX_TURN_COS2*lb*la)
+      return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+unsigned int MeshSimplifier::simplify(const float *vertices,unsigned int nbVertices,
+				      const unsigned int *faces,unsigned int nbFaces,
+				      unsigned int *result,unsigned int targetFaces,
+				      float maxError,float *error) {
+  vector<unsigned int> tris(faces,faces+3*(size_t)nbFaces);
+  vector<uint64_t>     edges;
+  vector<unsigned int> counts;
+  countEdges(tris,edges,counts);
+
+  // quadrics of the face planes, plus planes orthogonal to the faces
+  // along the boundary edges
+  vector<Quadric> quadrics(nbVertices);
+  vector<char>    boundary(nbVertices,0);
+
+  for(size_t t=0;t<tris.size();t+=3) {
+    const float *v[3] = {vertices+3*(size_t)tris[t],vertices+3*(size_t)tris[t+1],vertices+3*(size_t)tris[t+2]};
+    double n[3];
+    normal(v[0],v[1],v[2],n);
+    const double l = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+    if(l==0.0)
+      continue;
+    for(unsigned int j=0;j<3;++j)
+      n[j] /= l;
+
+    const double d = -(n[0]*v[0][0]+n[1]*v[0][1]+n[2]*v[0][2]);
+    for(unsigned int k=0;k<3;++k)
+      quadrics[tris[t+k]].add(n[0],n[1],n[2],d,0.5*l);
+
+    for(unsigned int k=0;k<3;++k) {
+      const unsigned int a = tris[t+k],b = tris[t+(k+1)%3];
+      if(!isBoundary(edges,counts,edgeKey(a,b)))
+	continue;
+
+      const double e[3] = {(double)v[(k+1)%3][0]-v[k][0],(double)v[(k+1)%3][1]-v[k][1],(double)v[(k+1)%3][2]-v[k][2]};
+      double m[3];
+      cross(e,n,m);
+      const double lm = sqrt(m[0]*m[0]+m[1]*m[1]+m[2]*m[2]);
+      if(lm==0.0)
+	continue;
+      for(unsigned int j=0;j<3;++j)
+	m[j] /= lm;
+
+      const double dm = -(m[0]*v[k][0]+m[1]*v[k][1]+m[2]*v[k][2]);
+      quadrics[a].add(m[0],m[1],m[2],dm,BOUNDARY_WEIGHT*lm);
+      quadrics[b].add(m[0],m[1],m[2],dm,BOUNDARY_WEIGHT*lm);
+      boundary[a] = boundary[b] = 1;
+    }
+  }
+
+  const double maxCost = (double)maxError*(double)maxError;
+  double worst = 0.0;
+
+  vector<Collapse>     collapses;
+  vector<unsigned int> first,around,remap(nbVertices);
+  vector<char>         locked(nbVertices);
+
+  // passes of independent collapses, cheapest first
+  for(bool firstPass=true;tris.size()/3>targetFaces;firstPass=false) {
+    if(!firstPass)
+      countEdges(tris,edges,counts);
+
+    collapses.clear();
+    for(size_t e=0;e<edges.size();++e) {
+      const unsigned int a = (unsigned int)(edges[e]>>32);
+      const unsigned int b = (unsigned int)(edges[e]&0xffffffffu);
+      const bool border = counts[e]==1;
+
+      // a boundary vertex only follows a boundary edge
+      const bool ab = !boundary[a] || (border && boundary[b]);
+      const bool ba = !boundary[b] || (border && boundary[a]);
+      if(!ab && !ba)
+	continue;
+
+      Quadric q = quadrics[a];
+      q.add(quadrics[b]);
+      const double cab = ab ? q.error(vertices+3*(size_t)b) : HUGE_VAL;
+      const double cba = ba ? q.error(vertices+3*(size_t)a) : HUGE_VAL;
+
+      Collapse c;
+      c.from = cab<=cba ? a : b;
+      c.to   = cab<=cba ? b : a;
+      c.cost = min(cab,cba);
+      if(c.cost<=maxCost)
+	collapses.push_back(c);
+    }
+    if(collapses.empty())
+      break;
+    sort(collapses.begin(),collapses.end(),cheaper);
+
+    // triangles around each vertex
+    first.assign(nbVertices+1,0);
+    for(size_t i=0;i<tris.size();++i)
+      first[tris[i]+1]++;
+    for(unsigned int v=0;v<nbVertices;++v)
+      first[v+1] += first[v];
+    around.resize(tris.size());
+    {
+      vector<unsigned int> pos(first.begin(),first.end()-1);
+      for(size_t i=0;i<tris.size();++i)
+	around[pos[tris[i]]++] = (unsigned int)(i/3);
+    }
+
+    for(unsigned int v=0;v<nbVertices;++v)
+      remap[v] = v;
+    fill(locked.begin(),locked.end(),0);
+
+    // a collapse removes about 2 triangles
+    const size_t needed = tris.size()/3-targetFaces;
+    size_t removed = 0;
+    unsigned int done = 0;
+
+    for(size_t i=0;i<collapses.size() && removed<needed;++i) {
+      const Collapse &c = collapses[i];
+      if(locked[c.from] || locked[c.to])
+	continue;
+      if(!keepsOrientation(vertices,tris,first,around,c.from,c.to))
+	continue;
+
+      remap[c.from] = c.to;
+      quadrics[c.to].add(quadrics[c.from]);
+      worst = max(worst,c.cost);
+      removed += boundary[c.from] ? 1 : 2;
+      done++;
+
+      // the triangles around from changed: their vertices wait next pass
+      for(unsigned int a=first[c.from];a<first[c.from+1];++a)
+	for(unsigned int k=0;k<3;++k)
+	  locked[tris[3*(size_t)around[a]+k]] = 1;
+    }
+    if(done==0)
+      break;
+
+    // apply, without the triangles that lost an edge
+    size_t n = 0;
+    for(size_t t=0;t<tris.size();t+=3) {
+      const unsigned int a = remap[tris[t]],b = remap[tris[t+1]],c = remap[tris[t+2]];
+      if(a==b || b==c || c==a)
+	continue;
+      tris[n++] = a;
+      tris[n++] = b;
+      tris[n++] = c;
+    }
+    tris.resize(n);
+  }
+
+  if(!tris.empty())
+    memcpy(result,&tris[0],tris.size()*sizeof(unsigned int));
+  if(error)
+    *error = (float)sqrt(worst);
+
+  return (unsigned int)(tris.size()/3);
+}
@@ -0,0 +1,22 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+// Simplification of an indexed triangle mesh by edge collapses ordered by
+// quadric error (Garland & Heckbert 1997). Vertices collapse onto one of
+// their neighbours, so the simplified triangles index the original vertex
+// arrays: all the levels of detail of a mesh share its vertex buffer.
+// Boundary vertices only slide along the boundary, collapses that would
+// flip a triangle are refused.
+class MeshSimplifier {
+ public:
+  // simplify faces (3 indices per triangle) towards targetFaces triangles,
+  // without going over maxError (distance, in the units of the vertices).
+  // result needs room for 3*nbFaces indices. Returns the number of
+  // triangles written, error gets the largest error of the collapses.
+  static unsigned int simplify(const float *vertices,unsigned int nbVertices,
+			       const unsigned int *faces,unsigned int nbFaces,
+			       unsigned int *result,unsigned int targetFaces,
+			       float maxError,float *error=0);
+};
+
+#endif // MESH_SIMPLIFIER_H
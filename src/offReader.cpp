@@ -0,0 +1,543 @@
+#include "offReader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// powers of ten exactly representable in float / double
+const float  POW10F[] = {1e0f,1e1f,1e2f,1e3f,1e4f,1e5f,1e6f,1e7f,1e8f,1e9f,1e10f};
+const double POW10D[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+			 1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+
+inline bool isBlank(char c) {return c==' ' || c=='\t' || c=='\r' || c=='\v' || c=='\f';}
+inline bool isDigit(char c) {return c>='0' && c<='9';}
+
+// slow but always correct conversion of [s,e)
+bool strtofToken(const char *s,const char *e,float &v) {
+  char buffer[64];
+  string big;
+  const size_t n = (size_t)(e-s);
+  const char *token = buffer;
+
+  if(n<sizeof(buffer)) {
+    memcpy(buffer,s,n);
+    buffer[n] = '\0';
+  } else {
+    big.assign(s,n);
+    token = big.c_str();
+  }
+
+  char *last;
+  v = strtof(token,&last);
+  return last==token+n;
+}
+
+// parse a float at p, the result is the one of strtof but without its
+// locale lookups in the common cases (up to 19 significant digits and
+// small exponents)
+bool parseFloat(const char *&p,const char *end,float &v) {
+  const char *s = p;
+
+  bool negative = false;
+  if(p<end && (*p=='-' || *p=='+')) {
+    negative = *p=='-';
+    ++p;
+  }
+
+  uint64_t m = 0;      // significant digits
+  int      digits = 0; // number of significant digits in m
+  int      exp = 0;    // v = m*10^exp
+  bool     any = false;
+  bool     truncated = false;
+
+  for(;p<end && isDigit(*p);++p) {
+    any = true;
+    if(digits<19) {
+      m = m*10+(uint64_t)(*p-'0');
+      if(m) digits++;
+    } else {
+      exp++;
+      truncated |= *p!='0';
+    }
+  }
+
+  if(p<end && *p=='.') {
+    for(++p;p<end && isDigit(*p);++p) {
+      any = true;
+      if(digits<19) {
+	m = m*10+(uint64_t)(*p-'0');
+	if(m) digits++;
+	exp--;
+      } else {
+	truncated |= *p!='0';
+      }
+    }
+  }
+
+  if(!any) {
+    // inf, nan...
+    while(p<end && !isBlank(*p) && *p!='\n') ++p;
+    return p>s && strtofToken(s,p,v);
+  }
+
+  if(p<end && (*p=='e' || *p=='E')) {
+    const char *q = p+1;
+    bool negativeExp = false;
+    if(q<end && (*q=='-' || *q=='+')) {
+      negativeExp = *q=='-';
+      ++q;
+    }
+
+    if(q<end && isDigit(*q)) {
+      int e = 0;
+      for(;q<end && isDigit(*q);++q)
+	if(e<100000) e = e*10+(*q-'0');
+      exp += negativeExp ? -e : e;
+      p = q;
+    }
+  }
+
+  if(!truncated && m<=(1u<<24) && exp>=-10 && exp<=10) {
+    // one correctly rounded float operation on exact values
+    const float f = (float)m;
+    v = exp<0 ? f/POW10F[-exp] : f*POW10F[exp];
+  } else if(!truncated && m<=((uint64_t)1<<53) && exp>=-22 && exp<=22) {
+    // correctly rounded double, then rounded to float: only wrong when
+    // the double falls exactly between two floats
+    const double d = (double)m;
+    const double r = exp<0 ? d/POW10D[-exp] : d*POW10D[exp];
+    const float  f = (float)r;
+    const float  g = nextafterf(f,r>(double)f ? INFINITY : -INFINITY);
+    if((double)f!=r && r==((double)f+(double)g)*0.5)
+      return strtofToken(s,p,v);
+    v = f;
+  } else {
+    return strtofToken(s,p,v);
+  }
+
+  if(negative)
+    v = -v;
+  return true;
+}
+
+// cursor in the file: one record (header, vertex, face) per line, blank
+// lines and # comments are skipped between the records
+struct Parser {
+  const char *begin; // of the file, for line numbers
+  const char *p;
+  const char *end;
+
+  Parser(const char *b,const char *s,const char *e) : begin(b),p(s),end(e) {}
+
+  // go to the start of the next record
+  void skip() {
+    while(p<end) {
+      if(isBlank(*p) || *p=='\n') {
+	++p;
+      } else if(*p=='#') {
+	nextLine();
+      } else {
+	break;
+      }
+    }
+  }
+
+  // ignore the end of the current line
+  void nextLine() {
+    const char *n = (const char *)memchr(p,'\n',(size_t)(end-p));
+    p = n ? n+1 : end;
+  }
+
+  bool readUInt(unsigned int &v) {
+    while(p<end && isBlank(*p)) ++p;
+    if(p>=end || !isDigit(*p))
+      return false;
+
+    uint64_t n = 0;
+    for(;p<end && isDigit(*p);++p) {
+      n = n*10+(uint64_t)(*p-'0');
+      if(n>0xffffffffu)
+	return false;
+    }
+    v = (unsigned int)n;
+    return true;
+  }
+
+  bool readFloat(float &v) {
+    while(p<end && isBlank(*p)) ++p;
+    return p<end && parseFloat(p,end,v);
+  }
+
+  // 1-based line of the cursor (for error messages only)
+  unsigned int line() const {
+    unsigned int n = 1;
+    for(const char *q=begin;q<p;++q)
+      if(*q=='\n') n++;
+    return n;
+  }
+};
+
+// the file mapped in memory (read only)
+struct MappedFile {
+  const char *data;
+  size_t      size;
+
+  MappedFile() : data(NULL),size(0) {}
+  ~MappedFile() {if(data) munmap((void *)data,size);}
+
+  bool open(const char *filename) {
+    const int fd = ::open(filename,O_RDONLY);
+    if(fd<0)
+      return false;
+
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size<=0) {
+      close(fd);
+      return false;
+    }
+
+    void *p = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(p==MAP_FAILED)
+      return false;
+
+    madvise(p,(size_t)st.st_size,MADV_SEQUENTIAL);
+    data = (const char *)p;
+    size = (size_t)st.st_size;
+    return true;
+  }
+};
+
+bool fail(const char *filename,const Parser *parser,const char *message,
+	  OffData &data,string &error) {
+  char text[64] = "";
+  if(parser)
+    snprintf(text,sizeof(text),":%u",parser->line());
+  error = string(filename)+text+": "+message;
+
+  free(data.vertices);
+  free(data.faces);
+  data = OffData();
+  return false;
+}
+
+// OFF nbVertices nbFaces nbEdges (counts possibly on the next lines)
+const char *parseHeader(Parser &parser,unsigned int &nbVertices,unsigned int &nbFaces) {
+  unsigned int nbEdges;
+
+  parser.skip();
+  if(parser.end-parser.p<3 || strncmp(parser.p,"OFF",3)!=0)
+    return "not an OFF file";
+  parser.p += 3;
+
+  parser.skip();
+  if(!parser.readUInt(nbVertices))
+    return "invalid header";
+  parser.skip();
+  if(!parser.readUInt(nbFaces))
+    return "invalid header";
+  parser.skip();
+  if(!parser.readUInt(nbEdges))
+    return "invalid header";
+  parser.nextLine();
+
+  return NULL;
+}
+
+// x y z [ignored values]
+const char *parseVertex(Parser &parser,float *v) {
+  if(!parser.readFloat(v[0]) || !parser.readFloat(v[1]) || !parser.readFloat(v[2]))
+    return "invalid vertex";
+  parser.nextLine();
+  return NULL;
+}
+
+// n i0 ... i(n-1) [ignored values]
+const char *parsePolygon(Parser &parser,unsigned int nbVertices,vector<unsigned int> &polygon) {
+  unsigned int n;
+  if(!parser.readUInt(n) || n<3)
+    return "invalid face size";
+
+  polygon.resize(n);
+  for(unsigned int j=0;j<n;++j) {
+    if(!parser.readUInt(polygon[j]))
+      return "invalid face index";
+    if(polygon[j]>=nbVertices)
+      return "face index out of range";
+  }
+  parser.nextLine();
+  return NULL;
+}
+
+// triangle fan around the first vertex of the polygon
+inline unsigned int *addFan(const vector<unsigned int> &polygon,unsigned int *f) {
+  for(size_t j=1;j+1<polygon.size();++j) {
+    *f++ = polygon[0];
+    *f++ = polygon[j];
+    *f++ = polygon[j+1];
+  }
+  return f;
+}
+
+// line aligned part of the records parsed by one task
+struct Chunk {
+  const char  *begin;
+  const char  *end;
+  unsigned int nbRecords;     // in this chunk
+  unsigned int firstRecord;   // index of its first record in the file
+  size_t       nbTriangles;   // made by its faces
+  size_t       firstTriangle;
+  const char  *errorPos;      // first error of the chunk, if any
+  const char  *errorMessage;
+};
+
+const size_t CHUNK_SIZE = 1<<20;
+
+// The records after the header are cut in line aligned chunks of about
+// CHUNK_SIZE bytes, parsed by the pool in 3 passes: count the records of
+// each chunk, parse the vertices (their index gives their place) and count
+// the triangles of the faces, then parse the faces at their place.
+bool readOffChunks(const char *filename,Parser &parser,unsigned int nbFaces,
+		   OffData &data,string &error,ThreadPool &pool) {
+  const unsigned int nbVertices = data.nbVertices;
+  const size_t       nbRecords  = (size_t)nbVertices+nbFaces;
+
+  vector<Chunk> chunks;
+  for(const char *s=parser.p;s<parser.end;) {
+    const char *e = parser.end;
+    if((size_t)(parser.end-s)>CHUNK_SIZE) {
+      const char *n = (const char *)memchr(s+CHUNK_SIZE,'\n',(size_t)(parser.end-s-CHUNK_SIZE));
+      e = n ? n+1 : parser.end;
+    }
+
+    Chunk c;
+    c.begin        = s;
+    c.end          = e;
+    c.nbRecords    = 0;
+    c.nbTriangles  = 0;
+    c.errorPos     = NULL;
+    c.errorMessage = NULL;
+    chunks.push_back(c);
+    s = e;
+  }
+  const unsigned int nbChunks = (unsigned int)chunks.size();
+
+  // to locate errors, the first one of the file wins
+  Parser at(parser.begin,NULL,parser.end);
+  const Chunk *failed = NULL;
+
+  // 1. records of each chunk
+  pool.parallelFor(0,nbChunks,1,[&](unsigned int first,unsigned int last) {
+      for(unsigned int c=first;c<last;++c) {
+	Parser p(parser.begin,chunks[c].begin,chunks[c].end);
+	for(p.skip();p.p<p.end;p.skip()) {
+	  chunks[c].nbRecords++;
+	  p.nextLine();
+	}
+      }
+    });
+
+  size_t record = 0;
+  for(unsigned int c=0;c<nbChunks;++c) {
+    chunks[c].firstRecord = (unsigned int)min(record,nbRecords);
+    record += chunks[c].nbRecords;
+  }
+  if(record<nbRecords) {
+    at.p = parser.end;
+    return fail(filename,&at,record<nbVertices ? "missing vertices" : "missing faces",data,error);
+  }
+
+  // 2. vertices, number of triangles of the faces
+  pool.parallelFor(0,nbChunks,1,[&](unsigned int first,unsigned int last) {
+      for(unsigned int c=first;c<last;++c) {
+	Chunk &chunk = chunks[c];
+	Parser p(parser.begin,chunk.begin,chunk.end);
+	unsigned int face;
+
+	for(size_t r=chunk.firstRecord;r<(size_t)chunk.firstRecord+chunk.nbRecords && r<nbRecords;++r) {
+	  p.skip();
+	  const char *m = NULL;
+
+	  if(r<nbVertices) {
+	    m = parseVertex(p,data.vertices+3*r);
+	  } else if(!p.readUInt(face) || face<3) {
+	    m = "invalid face size";
+	  } else {
+	    chunk.nbTriangles += face-2;
+	    p.nextLine();
+	  }
+
+	  if(m) {
+	    chunk.errorPos     = p.p;
+	    chunk.errorMessage = m;
+	    break;
+	  }
+	}
+      }
+    });
+
+  for(unsigned int c=0;c<nbChunks && !failed;++c)
+    if(chunks[c].errorPos) failed = &chunks[c];
+  if(failed) {
+    at.p = failed->errorPos;
+    return fail(filename,&at,failed->errorMessage,data,error);
+  }
+
+  size_t nbTriangles = 0;
+  for(unsigned int c=0;c<nbChunks;++c) {
+    chunks[c].firstTriangle = nbTriangles;
+    nbTriangles += chunks[c].nbTriangles;
+  }
+
+  data.faces = (unsigned int *)malloc(3*nbTriangles*sizeof(unsigned int));
+  if(nbTriangles && !data.faces)
+    return fail(filename,NULL,"out of memory",data,error);
+  data.nbFaces = (unsigned int)nbTriangles;
+
+  // 3. faces
+  pool.parallelFor(0,nbChunks,1,[&](unsigned int first,unsigned int last) {
+      vector<unsigned int> polygon;
+
+      for(unsigned int c=first;c<last;++c) {
+	Chunk &chunk = chunks[c];
+	if((size_t)chunk.firstRecord+chunk.nbRecords<=nbVertices || chunk.firstRecord>=nbRecords)
+	  continue;
+
+	Parser p(parser.begin,chunk.begin,chunk.end);
+	unsigned int *f = data.faces+3*chunk.firstTriangle;
+
+	for(size_t r=chunk.firstRecord;r<(size_t)chunk.firstRecord+chunk.nbRecords && r<nbRecords;++r) {
+	  p.skip();
+	  if(r<nbVertices) {
+	    p.nextLine();
+	    continue;
+	  }
+
+	  const char *m = parsePolygon(p,nbVertices,polygon);
+	  if(m) {
+	    chunk.errorPos     = p.p;
+	    chunk.errorMessage = m;
+	    break;
+	  }
+	  f = addFan(polygon,f);
+	}
+      }
+    });
+
+  for(unsigned int c=0;c<nbChunks && !failed;++c)
+    if(chunks[c].errorPos) failed = &chunks[c];
+  if(failed) {
+    at.p = failed->errorPos;
+    return fail(filename,&at,failed->errorMessage,data,error);
+  }
+
+  return true;
+}
+
+} // namespace
+
+bool readOff(const char *filename,OffData &data,string &error,ThreadPool *pool) {
+  data = OffData();
+
+  MappedFile file;
+  if(!file.open(filename))
+    return fail(filename,NULL,"unable to read the file",data,error);
+
+  Parser parser(file.data,file.data,file.data+file.size);
+
+  unsigned int nbVertices,nbFaces;
+  const char *message = parseHeader(parser,nbVertices,nbFaces);
+  if(message)
+    return fail(filename,&parser,message,data,error);
+
+  data.nbVertices = nbVertices;
+  data.vertices   = (float *)malloc(3*(size_t)nbVertices*sizeof(float));
+  if(nbVertices && !data.vertices)
+    return fail(filename,NULL,"out of memory",data,error);
+
+  if(pool)
+    return readOffChunks(filename,parser,nbFaces,data,error,*pool);
+
+  for(unsigned int i=0;i<nbVertices;++i) {
+    parser.skip();
+    if((message=parseVertex(parser,data.vertices+3*(size_t)i)))
+      return fail(filename,&parser,message,data,error);
+  }
+
+  // polygons are split in triangles
+  size_t capacity = 3*(size_t)nbFaces;
+  size_t nb = 0;
+  data.faces = (unsigned int *)malloc(capacity*sizeof(unsigned int));
+  if(capacity && !data.faces)
+    return fail(filename,NULL,"out of memory",data,error);
+
+  vector<unsigned int> polygon;
+  for(unsigned int i=0;i<nbFaces;++i) {
+    parser.skip();
+    if((message=parsePolygon(parser,nbVertices,polygon)))
+      return fail(filename,&parser,message,data,error);
+
+    const size_t n = 3*(polygon.size()-2);
+    if(nb+n>capacity) {
+      capacity = max(2*capacity,nb+n);
+      unsigned int *faces = (unsigned int *)realloc(data.faces,capacity*sizeof(unsigned int));
+      if(!faces)
+	return fail(filename,NULL,"out of memory",data,error);
+      data.faces = faces;
+    }
+    nb = (size_t)(addFan(polygon,data.faces+nb)-data.faces);
+  }
+  data.nbFaces = (unsigned int)(nb/3);
+
+  return true;
+}
+
+bool readOffScanf(const char *filename,OffData &data,string &error) {
+  data = OffData();
+
+  FILE *file = fopen(filename,"r");
+  if(!file)
+    return fail(filename,NULL,"unable to open the file",data,error);
+
+  unsigned int nbVertices,nbFaces,tmp;
+  if(fscanf(file,"OFF\n%u %u %u\n",&nbVertices,&nbFaces,&tmp)!=3) {
+    fclose(file);
+    return fail(filename,NULL,"invalid header",data,error);
+  }
+
+  data.nbVertices = nbVertices;
+  data.nbFaces    = nbFaces;
+  data.vertices   = (float *)malloc(3*(size_t)nbVertices*sizeof(float));
+  data.faces      = (unsigned int *)malloc(3*(size_t)nbFaces*sizeof(unsigned int));
+
+  float *v = data.vertices;
+  for(unsigned int i=0;i<nbVertices;++i,v+=3) {
+    if(fscanf(file,"%f %f %f\n",&v[0],&v[1],&v[2])!=3) {
+      fclose(file);
+      return fail(filename,NULL,"invalid vertex",data,error);
+    }
+  }
+
+  unsigned int *f = data.faces;
+  for(unsigned int i=0;i<nbFaces;++i,f+=3) {
+    if(fscanf(file,"%u %u %u %u\n",&tmp,&f[0],&f[1],&f[2])!=4 || tmp!=3) {
+      fclose(file);
+      return fail(filename,NULL,"invalid face",data,error);
+    }
+  }
+
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,32 @@
+#ifndef OFF_READER_H
+#define OFF_READER_H
+
+#include <string>
+
+#include "threadPool.h"
+
+// Content of an OFF file: arrays allocated with malloc, to be released
+// with free by their owner (see Mesh).
+struct OffData {
+  unsigned int  nbVertices;
+  unsigned int  nbFaces;    // triangles
+  float        *vertices;   // 3 floats per vertex
+  unsigned int *faces;      // 3 indices per triangle
+
+  OffData() : nbVertices(0),nbFaces(0),vertices(NULL),faces(NULL) {}
+};
+
+// Map the file in memory and parse it with a hand-written tokenizer
+// (locale independent, correctly rounded floats). One vertex or face per
+// line: extra values at the end of the lines (colors) are ignored,
+// polygons are split in triangle fans. With a pool, the records are cut
+// in line aligned chunks parsed concurrently, directly into data. On
+// failure, data is left empty and error describes the problem
+// (file:line: message).
+bool readOff(const char *filename,OffData &data,std::string &error,ThreadPool *pool=NULL);
+
+// The former fscanf based loader, kept as a reference for benchmarks
+// (triangles only).
+bool readOffScanf(const char *filename,OffData &data,std::string &error);
+
+#endif // OFF_READER_H
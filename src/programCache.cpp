@@ -0,0 +1,128 @@
+#include "programCache.h"
+#include "fileUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = "SIMPROG";
+
+// FNV-1a
+uint64_t hashBytes(const void *data,size_t n,uint64_t h) {
+  const unsigned char *p = (const unsigned char *)data;
+  for(size_t i=0;i<n;++i)
+    h = (h^p[i])*1099511628211ull;
+  return h;
+}
+
+uint64_t hashString(const char *s,uint64_t h) {
+  // the terminating 0 separates consecutive strings
+  return s ? hashBytes(s,strlen(s)+1,h) : hashBytes("",1,h);
+}
+
+string directory(const char *vertexFile) {
+  const char *slash = strrchr(vertexFile,'/');
+  return slash ? string(vertexFile,slash-vertexFile+1)+"cache" : string("cache");
+}
+
+} // namespace
+
+bool ProgramCache::supported() {
+  if(!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+    return false;
+
+  GLint nbFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&nbFormats);
+  return nbFormats>0;
+}
+
+uint64_t ProgramCache::initialKey() {
+  const uint32_t version = VERSION;
+  uint64_t key = hashBytes(&version,sizeof(version),14695981039346656037ull);
+  key = hashString((const char *)glGetString(GL_VENDOR),key);
+  key = hashString((const char *)glGetString(GL_RENDERER),key);
+  key = hashString((const char *)glGetString(GL_VERSION),key);
+  return key;
+}
+
+uint64_t ProgramCache::addStage(uint64_t key,GLenum type,const string &code) {
+  key = hashBytes(&type,sizeof(type),key);
+  return hashString(code.c_str(),key);
+}
+
+string ProgramCache::path(const char *vertexFile,uint64_t key) {
+  char name[32];
+  snprintf(name,sizeof(name),"/%016llx.prog",(unsigned long long)key);
+  return directory(vertexFile)+name;
+}
+
+bool ProgramCache::load(const char *vertexFile,uint64_t key,GLuint program) {
+  if(!supported())
+    return false;
+
+  const string file = path(vertexFile,key);
+  const int fd = open(file.c_str(),O_RDONLY);
+  if(fd<0)
+    return false;
+
+  Header h;
+  struct stat st;
+  const bool valid =
+    fstat(fd,&st)==0 && readAll(fd,&h,sizeof(h)) &&
+    memcmp(h.magic,MAGIC,sizeof(MAGIC))==0 && h.version==VERSION && h.key==key &&
+    h.size>0 && sizeof(h)+h.size==(uint64_t)st.st_size;
+
+  vector<char> binary;
+  if(valid) {
+    binary.resize((size_t)h.size);
+    if(!readAll(fd,&binary[0],binary.size()))
+      binary.clear();
+  }
+  close(fd);
+
+  if(binary.empty())
+    return false;
+
+  // the driver may refuse it (other build of the driver, other GPU)
+  glProgramBinary(program,h.format,&binary[0],(GLsizei)binary.size());
+  GLint status = GL_FALSE;
+  glGetProgramiv(program,GL_LINK_STATUS,&status);
+  return status==GL_TRUE;
+}
+
+bool ProgramCache::save(const char *vertexFile,uint64_t key,GLuint program) {
+  if(!supported())
+    return false;
+
+  GLint size = 0;
+  glGetProgramiv(program,GL_PROGRAM_BINARY_LENGTH,&size);
+  if(size<=0)
+    return false;
+
+  Header h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,MAGIC,sizeof(MAGIC));
+  h.version = VERSION;
+  h.key     = key;
+
+  vector<char> binary((size_t)size);
+  GLsizei length = 0;
+  GLenum format  = 0;
+  glGetProgramBinary(program,size,&length,&format,&binary[0]);
+  if(length<=0)
+    return false;
+  h.format = format;
+  h.size   = (uint64_t)length;
+
+  mkdir(directory(vertexFile).c_str(),0755);
+  return writeFileAtomic(path(vertexFile,key),[&](int fd) {
+      return writeAll(fd,&h,sizeof(h)) && writeAll(fd,&binary[0],(size_t)length);
+    });
+}
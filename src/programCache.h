@@ -0,0 +1,42 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <string>
+
+// Linked programs saved as driver binaries (glGetProgramBinary) in a
+// "cache" directory next to their vertex shader, one file per key. The key
+// hashes the stages (type and source text) with the GL vendor, renderer and
+// version strings: editing a shader or updating the driver gives another
+// file. Any failure (no binary format, file missing or rejected by the
+// driver) just means compiling from the sources.
+class ProgramCache {
+ public:
+  static const uint32_t VERSION = 1;
+
+  struct Header {
+    char     magic[8];    // "SIMPROG"
+    uint32_t version;     // VERSION
+    uint32_t format;      // binary format of the driver
+    uint64_t key;
+    uint64_t size;        // bytes of the binary, after the header
+  };
+
+  // true if the driver can save and load program binaries
+  static bool supported();
+
+  // add a stage to the key (start with key=initialKey())
+  static uint64_t initialKey();
+  static uint64_t addStage(uint64_t key,GLenum type,const std::string &code);
+
+  static std::string path(const char *vertexFile,uint64_t key);
+
+  // give program the cached binary (false: nothing usable, compile it)
+  static bool load(const char *vertexFile,uint64_t key,GLuint program);
+
+  // write the binary of a linked program (false on failure)
+  static bool save(const char *vertexFile,uint64_t key,GLuint program);
+};
+
+#endif // PROGRAM_CACHE_H
@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "programCache.h"
 
 #include <stdio.h>
 #include <vector>
@@ -10,62 +11,210 @@
 
 using namespace std;
 
+map<string,GLuint> Shader::_blockBindings;
+
 Shader::Shader() :
   _programId(0) {
   
 }
 
 Shader::~Shader() {
+  discardBuild();
   if(glIsProgram(_programId)) {
     glDeleteProgram(_programId);
   }
 }
 
 void Shader::load(const char *vertex_file_path,
-		  const char *fragment_file_path) {
+		  const char *fragment_file_path,
+		  const char *tess_control_file_path,
+		  const char *tess_evaluation_file_path) {
   
-  // create and compile vertex shader object
-  std::string vertexCode   = getCode(vertex_file_path);
-  const char * vertexCodeC = vertexCode.c_str();
-  GLuint vertexId   = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexId,1,&(vertexCodeC),NULL);
-  glCompileShader(vertexId);
-  cout << vertex_file_path << " :" << endl;
-  checkCompilation(vertexId);
-
-  // create and compile fragment shader object
-  std::string fragmentCode = getCode(fragment_file_path);
-  const char * fragmentCodeC = fragmentCode.c_str();
-  GLuint fragmentId = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentId,1,&(fragmentCodeC),NULL);
-  glCompileShader(fragmentId);
-  cout << fragment_file_path << " :" << endl;
-  checkCompilation(fragmentId);
-
-  // create, attach and link program object
-  _programId = glCreateProgram();
-  glAttachShader(_programId,vertexId);
-  glAttachShader(_programId,fragmentId);
-  glLinkProgram(_programId);
-  checkLinks(_programId);
-
-  // delete vertex and fragment ids
-  glDeleteShader(vertexId);
-  glDeleteShader(fragmentId);
+  loadAsync(vertex_file_path,fragment_file_path,
+	    tess_control_file_path,tess_evaluation_file_path);
+  finish(true);
 }
 
 
 void Shader::reload(const char *vertex_file_path,
-		    const char *fragment_file_path) {
+		    const char *fragment_file_path,
+		    const char *tess_control_file_path,
+		    const char *tess_evaluation_file_path) {
   
-  // check if the program already contains a shader 
-  if(glIsProgram(_programId)) {
-    // delete it...
+  // the current program stays until the new one links
+  load(vertex_file_path,fragment_file_path,
+       tess_control_file_path,tess_evaluation_file_path);
+}
+
+void Shader::loadAsync(const char *vertex_file_path,
+		       const char *fragment_file_path,
+		       const char *tess_control_file_path,
+		       const char *tess_evaluation_file_path) {
+
+  static const GLenum types[NB_STAGES] = {
+    GL_VERTEX_SHADER,GL_FRAGMENT_SHADER,GL_TESS_CONTROL_SHADER,GL_TESS_EVALUATION_SHADER
+  };
+  const char *files[NB_STAGES] = {
+    vertex_file_path,fragment_file_path,tess_control_file_path,tess_evaluation_file_path
+  };
+
+  // a newer request replaces the one in progress
+  discardBuild();
+  _dependencies.clear();
+
+  // tessellation stages are optional
+  const unsigned int nb = tess_control_file_path && tess_evaluation_file_path ? 4 : 2;
+  string codes[NB_STAGES];
+  for(unsigned int i=0;i<NB_STAGES;++i) {
+    _files[i] = i<nb ? files[i] : "";
+    if(i<nb)
+      codes[i] = getCode(files[i]);
+  }
+
+  // same sources on the same driver: reuse the program linked last time
+  _build.program = glCreateProgram();
+  _build.cache   = ProgramCache::supported();
+  if(_build.cache) {
+    _build.key = ProgramCache::initialKey();
+    for(unsigned int i=0;i<nb;++i)
+      _build.key = ProgramCache::addStage(_build.key,types[i],codes[i]);
+
+    if(ProgramCache::load(vertex_file_path,_build.key,_build.program)) {
+      _build.cached = true;
+      return;
+    }
+
+    // a rejected binary may have left the program unusable
+    glDeleteProgram(_build.program);
+    _build.program = glCreateProgram();
+    glProgramParameteri(_build.program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+  }
+
+  // create, compile and attach the shader objects, then link: nothing
+  // waits for the results before finish
+  for(unsigned int i=0;i<nb;++i) {
+    _build.shaders[i] = compile(types[i],codes[i]);
+    glAttachShader(_build.program,_build.shaders[i]);
+  }
+  _build.nbShaders = nb;
+  glLinkProgram(_build.program);
+}
+
+bool Shader::parallelCompile() {
+  return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+bool Shader::finish(bool wait) {
+  if(_build.program==0)
+    return false;
+
+  // querying the status before the driver is done would block
+  if(!wait && !_build.cached && parallelCompile()) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(_build.program,GL_COMPLETION_STATUS_KHR,&done);
+    if(done==GL_FALSE)
+      return false;
+  }
+
+  bool linked = true;
+  if(_build.cached) {
+    cout << _files[0] << " : cached program" << endl;
+  } else {
+    for(unsigned int i=0;i<_build.nbShaders;++i) {
+      cout << _files[i] << " :" << endl;
+      checkCompilation(_build.shaders[i]);
+    }
+    linked = checkLinks(_build.program);
+    if(linked && _build.cache && !ProgramCache::save(_files[0].c_str(),_build.key,_build.program))
+      cout << "Unable to write " << ProgramCache::path(_files[0].c_str(),_build.key) << endl;
+  }
+
+  if(!linked) {
+    for(unsigned int i=0;i<_dependencies.size();++i)
+      cout << "source " << i << ": " << _dependencies[i] << endl;
+    if(_programId!=0)
+      cout << "Keeping the previous program of " << _files[0] << endl;
+    discardBuild();
+    return false;
+  }
+
+  if(glIsProgram(_programId))
     glDeleteProgram(_programId);
+  _programId     = _build.program;
+  _build.program = 0;
+  discardBuild();
+  setupProgram();
+
+  return true;
+}
+
+void Shader::discardBuild() {
+  // shaders are released with the program they are attached to
+  for(unsigned int i=0;i<_build.nbShaders;++i)
+    glDeleteShader(_build.shaders[i]);
+  if(_build.program!=0)
+    glDeleteProgram(_build.program);
+  _build = Build();
+}
+
+GLint Shader::uniform(const char *name) const {
+  map<string,GLint>::const_iterator it = _locations.find(name);
+  return it==_locations.end() ? -1 : it->second;
+}
+
+void Shader::define(const std::string &name,const std::string &value) {
+  _defines[name] = value;
+}
+
+void Shader::undefine(const std::string &name) {
+  _defines.erase(name);
+}
+
+void Shader::bindBlock(const char *name,GLuint binding) {
+  _blockBindings[name] = binding;
+}
+
+void Shader::setupProgram() {
+  // query the locations once instead of at each draw
+  _locations.clear();
+
+  GLint nbUniforms = 0,maxLength = 0;
+  glGetProgramiv(_programId,GL_ACTIVE_UNIFORMS,&nbUniforms);
+  glGetProgramiv(_programId,GL_ACTIVE_UNIFORM_MAX_LENGTH,&maxLength);
+
+  std::vector<char> name(maxLength+1);
+  for(GLint i=0;i<nbUniforms;++i) {
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(_programId,(GLuint)i,maxLength+1,NULL,&size,&type,&name[0]);
+
+    // members of uniform blocks have no location
+    const GLint location = glGetUniformLocation(_programId,&name[0]);
+    if(location<0)
+      continue;
+
+    // arrays are reported as "name[0]": also accept "name"
+    string n(&name[0]);
+    _locations[n] = location;
+    if(n.size()>3 && n.compare(n.size()-3,3,"[0]")==0)
+      _locations[n.substr(0,n.size()-3)] = location;
   }
 
-  // ... and reload it
-  load(vertex_file_path,fragment_file_path);
+  // uniform blocks shared between the programs
+  for(map<string,GLuint>::const_iterator it=_blockBindings.begin();it!=_blockBindings.end();++it) {
+    const GLuint index = glGetUniformBlockIndex(_programId,it->first.c_str());
+    if(index!=GL_INVALID_INDEX)
+      glUniformBlockBinding(_programId,index,it->second);
+  }
+}
+
+GLuint Shader::compile(GLenum type,const std::string &code) {
+  const char *codeC = code.c_str();
+  GLuint id = glCreateShader(type);
+  glShaderSource(id,1,&(codeC),NULL);
+  glCompileShader(id);
+
+  return id;
 }
 
 
@@ -87,7 +236,7 @@ void Shader::checkCompilation(GLuint shaderId) {
   }
 }
 
-void Shader::checkLinks(GLuint programId) {
+bool Shader::checkLinks(GLuint programId) {
   // check if links were successfull (and display errors)
   // call it after linking the program  
   GLint result = GL_FALSE;
@@ -101,22 +250,75 @@ void Shader::checkLinks(GLuint programId) {
     glGetProgramInfoLog(programId,infoLogLength,NULL,&message[0]);
     printf("%s\n", &message[0]);
   }
+
+  return result==GL_TRUE;
 }
 
 std::string Shader::getCode(const char *file_path) {
-  // return a string containing the source code of the input file
-  std::string   shaderCode;
-  std::ifstream shaderStream(file_path,std::ios::in);
+  std::set<std::string> included;
+  std::string code;
+  expand(file_path,code,included);
+  return code;
+}
+
+// true if the line is the given directive
+static bool isDirective(const std::string &line,const char *directive,size_t &first) {
+  first = line.find_first_not_of(" \t");
+  return first!=std::string::npos && line.compare(first,strlen(directive),directive)==0;
+}
+
+void Shader::expand(const std::string &file_path,std::string &code,std::set<std::string> &included) {
+  // the libraries may include each other
+  if(!included.insert(file_path).second)
+    return;
 
+  std::ifstream shaderStream(file_path.c_str(),std::ios::in);
   if(!shaderStream.is_open()) {
     cout << "Unable to open " << file_path << endl;
-    return "";
+    return;
   }
 
+  // source string number of the file in the logs
+  const size_t number = find(_dependencies.begin(),_dependencies.end(),file_path)-_dependencies.begin();
+  if(number==_dependencies.size())
+    _dependencies.push_back(file_path);
+  char directive[64];
+
+  // the top file starts with its #version
+  if(included.size()>1) {
+    snprintf(directive,sizeof(directive),"#line 1 %u\n",(unsigned int)number);
+    code += directive;
+  }
+
+  const size_t slash = file_path.rfind('/');
+  const std::string directory = slash==std::string::npos ? "" : file_path.substr(0,slash+1);
+
   std::string line = "";
-  while(getline(shaderStream,line))
-    shaderCode += "\n" + line;
-  shaderStream.close();
-  
-  return shaderCode;
+  unsigned int n = 0;
+  while(getline(shaderStream,line)) {
+    ++n;
+
+    size_t first;
+    if(isDirective(line,"#include",first)) {
+      const size_t a = line.find('"',first);
+      const size_t b = a==std::string::npos ? a : line.find('"',a+1);
+      if(b!=std::string::npos) {
+	expand(directory+line.substr(a+1,b-a-1),code,included);
+	snprintf(directive,sizeof(directive),"#line %u %u\n",n+1,(unsigned int)number);
+	code += directive;
+	continue;
+      }
+    }
+
+    code += line+"\n";
+
+    // the permutation, then back to the numbers (and the source string)
+    // of the file
+    if(isDirective(line,"#version",first)) {
+      for(map<string,string>::const_iterator it=_defines.begin();it!=_defines.end();++it)
+	code += "#define "+it->first+" "+it->second+"\n";
+      snprintf(directive,sizeof(directive),"#line %u %u\n",n+1,(unsigned int)number);
+      code += directive;
+    }
+  }
 }
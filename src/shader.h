@@ -2,32 +2,123 @@
 #define SHADER_H
 
 #include <GL/glew.h>
+#include <stdint.h>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 class Shader {
  public:
   Shader();
   ~Shader();
 
+  // tessellation stages are optional. The sources go through a small
+  // preprocessor: #include "file" (relative to the including file, each
+  // file once per stage) and the defines of the permutation (see define).
+  // The linked program is kept in a binary cache (see ProgramCache) and
+  // reused while the sources and the driver stay the same. The current
+  // program is only replaced once the new one links
   void load(const char *vertex_file_path,
-	    const char *fragment_file_path);
+	    const char *fragment_file_path,
+	    const char *tess_control_file_path=NULL,
+	    const char *tess_evaluation_file_path=NULL);
   
   void reload(const char *vertex_file_path,
-	      const char *fragment_file_path);
+	      const char *fragment_file_path,
+	      const char *tess_control_file_path=NULL,
+	      const char *tess_evaluation_file_path=NULL);
 
-  inline GLuint id() {return _programId;}
+  // start building a program from the files without waiting for the
+  // driver (compiled by its threads with KHR_parallel_shader_compile):
+  // the current program stays in use until poll swaps it
+  void loadAsync(const char *vertex_file_path,
+		 const char *fragment_file_path,
+		 const char *tess_control_file_path=NULL,
+		 const char *tess_evaluation_file_path=NULL);
+
+  // true once the program started by loadAsync linked and replaced the
+  // current one. A failure prints the logs and keeps the current program
+  inline bool poll() {return finish(false);}
+
+  inline bool building() const {return _build.program!=0;}
+
+  inline GLuint id() const {return _programId;}
+
+  // files given to the last load (empty: no such stage)
+  inline const std::string &file(unsigned int stage) const {return _files[stage];}
+
+  // every file read by the last load, includes too (source string k of
+  // the logs is dependencies()[k])
+  inline const std::vector<std::string> &dependencies() const {return _dependencies;}
+
+  // permutation of the program: "#define name value" right after the
+  // #version line of every stage, from the next load. The defines are
+  // part of the sources, hence of the key of the binary cache
+  void define(const std::string &name,const std::string &value="1");
+  void undefine(const std::string &name);
+
+  // location of an active uniform (-1 if unknown), cached at link time
+  GLint uniform(const char *name) const;
+
+  // every program declaring the uniform block gets this binding point
+  static void bindBlock(const char *name,GLuint binding);
+
+  // true if the driver compiles and links in the background
+  static bool parallelCompile();
 
  private:
-  GLuint _programId;
+  // vertex, fragment, tessellation control and evaluation
+  static const unsigned int NB_STAGES = 4;
+
+  // program being compiled and linked (see loadAsync)
+  struct Build {
+    GLuint       program;
+    GLuint       shaders[NB_STAGES];
+    unsigned int nbShaders;
+    bool         cache;  // the binary may be saved
+    bool         cached; // the binary was loaded
+    uint64_t     key;
 
-  // string containing the source code of the input file
+    Build() : program(0),nbShaders(0),cache(false),cached(false),key(0) {}
+  };
+
+  GLuint      _programId;
+  Build       _build;
+  std::string _files[NB_STAGES];
+  std::vector<std::string> _dependencies;
+  std::map<std::string,std::string> _defines;
+
+  // active uniforms of the program and their locations
+  std::map<std::string,GLint> _locations;
+
+  // uniform block name -> binding point, shared by all the programs
+  static std::map<std::string,GLuint> _blockBindings;
+
+  // check and install the program being built (wait: even if the driver
+  // has not finished yet). True if it replaced the current one
+  bool finish(bool wait);
+
+  // drop the program being built
+  void discardBuild();
+
+  // fill the location cache and bind the known uniform blocks
+  void setupProgram();
+
+  // source code of a stage, preprocessed
   std::string getCode(const char *file_path);
 
+  // append the lines of the file to code, includes expanded
+  void expand(const std::string &file_path,std::string &code,std::set<std::string> &included);
+
+  // create and start compiling a shader object of the given type
+  GLuint compile(GLenum type,const std::string &code);
+
   // call it after each shader compilation
   void checkCompilation(GLuint shaderId);
 
-  // call it after linking the program
-  void checkLinks(GLuint programId);
+  // call it after linking the program (false if it failed)
+  bool checkLinks(GLuint programId);
 };
 
 #endif // SHADER_H
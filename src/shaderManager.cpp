@@ -0,0 +1,131 @@
+#include "shaderManager.h"
+
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+// modification time of a file (0 if it does not exist)
+int64_t modificationTime(const string &file) {
+  struct stat st;
+  if(file.empty() || stat(file.c_str(),&st)!=0)
+    return 0;
+  return (int64_t)st.st_mtim.tv_sec*1000000000+st.st_mtim.tv_nsec;
+}
+
+inline const char *stageFile(const string &file) {
+  return file.empty() ? NULL : file.c_str();
+}
+
+} // namespace
+
+ShaderManager::ShaderManager()
+  : _lastCheck(chrono::steady_clock::now()) {
+
+  // let the driver use as many threads as it wants
+  if(GLEW_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xffffffffu);
+  else if(GLEW_ARB_parallel_shader_compile)
+    glMaxShaderCompilerThreadsARB(0xffffffffu);
+}
+
+void ShaderManager::add(Shader *shader,const Callback &swapped) {
+  if(!shader)
+    return;
+
+  Entry e;
+  e.shader  = shader;
+  e.swapped = swapped;
+  e.dirty   = false;
+  watch(e);
+  _entries.push_back(e);
+}
+
+void ShaderManager::remove(Shader *shader) {
+  for(unsigned int i=0;i<_entries.size();++i) {
+    if(_entries[i].shader==shader) {
+      _entries.erase(_entries.begin()+i);
+      return;
+    }
+  }
+}
+
+void ShaderManager::clear() {
+  _entries.clear();
+}
+
+void ShaderManager::watch(Entry &e) const {
+  e.files = e.shader->dependencies();
+  e.mtimes.resize(e.files.size());
+  for(unsigned int i=0;i<e.files.size();++i)
+    e.mtimes[i] = modificationTime(e.files[i]);
+}
+
+bool ShaderManager::changed(Entry &e) const {
+  bool changed = false;
+  for(unsigned int i=0;i<e.files.size();++i) {
+    const int64_t t = modificationTime(e.files[i]);
+    changed  = changed || t!=e.mtimes[i];
+    e.mtimes[i] = t;
+  }
+  return changed;
+}
+
+void ShaderManager::rebuild(Entry &e) const {
+  // a rebuild in progress may have read the file before its last change
+  if(e.shader->building()) {
+    e.dirty = true;
+    return;
+  }
+
+  // copies: loadAsync replaces the files of the shader
+  string files[4];
+  for(unsigned int i=0;i<4;++i)
+    files[i] = e.shader->file(i);
+
+  e.dirty = false;
+  e.shader->loadAsync(stageFile(files[0]),stageFile(files[1]),
+		      stageFile(files[2]),stageFile(files[3]));
+
+  // an include may have been added or removed
+  watch(e);
+}
+
+void ShaderManager::reloadAll() {
+  for(unsigned int i=0;i<_entries.size();++i)
+    rebuild(_entries[i]);
+}
+
+bool ShaderManager::update() {
+  bool updated = false;
+
+  // install the programs the driver is done with
+  for(unsigned int i=0;i<_entries.size();++i) {
+    Entry &e = _entries[i];
+    if(!e.shader->building())
+      continue;
+
+    const bool swapped = e.shader->poll();
+    if(!e.shader->building() && e.dirty)
+      rebuild(e);
+    if(swapped && e.swapped)
+      e.swapped();
+    updated = updated || swapped;
+  }
+
+  const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  if(now-_lastCheck<chrono::milliseconds(CHECK_INTERVAL))
+    return updated;
+  _lastCheck = now;
+
+  for(unsigned int i=0;i<_entries.size();++i) {
+    if(changed(_entries[i])) {
+      cout << "Reloading " << _entries[i].shader->file(0) << endl;
+      rebuild(_entries[i]);
+    }
+  }
+
+  return updated;
+}
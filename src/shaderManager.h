@@ -0,0 +1,61 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "shader.h"
+
+// Hot reload of the shaders: watches the source files of the programs it
+// is given (with the files they include) and rebuilds a program in the
+// background (Shader::loadAsync) when one of them changes. The new
+// program replaces the old one at the frame where the driver has linked
+// it; a program that fails to compile or link is dropped and the old one
+// stays in use, so editing a shader never stalls a frame nor leaves a
+// black screen.
+class ShaderManager {
+ public:
+  // called after a rebuilt program replaced the old one
+  typedef std::function<void()> Callback;
+
+  // files are looked at every CHECK_INTERVAL ms at most
+  static const int CHECK_INTERVAL = 250;
+
+  ShaderManager();
+
+  // watch the files of a loaded shader (not owned)
+  void add(Shader *shader,const Callback &swapped=Callback());
+  void remove(Shader *shader);
+  void clear();
+
+  // rebuild all the programs, changed or not (key r)
+  void reloadAll();
+
+  // once per frame: start the rebuilds of the changed programs and install
+  // the finished ones (false if nothing changed)
+  bool update();
+
+ private:
+  struct Entry {
+    Shader  *shader;
+    Callback swapped;
+    std::vector<std::string> files;  // Shader::dependencies
+    std::vector<int64_t>     mtimes; // of the files, nanoseconds
+    bool     dirty;     // changed while building, start again
+  };
+
+  // files read by the last load of the shader and their dates
+  void watch(Entry &e) const;
+
+  // true if a file of the entry changed since the last call
+  bool changed(Entry &e) const;
+
+  void rebuild(Entry &e) const;
+
+  std::vector<Entry> _entries;
+  std::chrono::steady_clock::time_point _lastCheck;
+};
+
+#endif // SHADER_MANAGER_H
@@ -1,28 +1,40 @@
 #version 330
 
 // input attributes
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
+layout(location = 0) in vec3 position; // in the bounding sphere, [-1,1]
+layout(location = 1) in vec2 normal;   // octahedral encoding
+layout(location = 2) in mat4 model;   // per instance (locations 2 to 5)
 
 // input uniforms
-uniform mat4 mdvMat;      // modelview matrix
-uniform mat4 projMat;     // projection matrix
-uniform mat3 normalMat;   // normal matrix
-uniform float _y;
+#include "frameData.glsl"
+
+// bounding sphere of the mesh (see MeshPacker)
+uniform vec3  meshCenter;
+uniform float meshRadius;
 
 // out variables
 out vec3 normalView;
 out vec3 eyeView;
 out vec3 p;
 
+// unit vector from its octahedral encoding
+vec3 octDecode(vec2 e) {
+    vec3  n = vec3(e,1.0-abs(e.x)-abs(e.y));
+    float t = max(-n.z,0.0);
+    n.xy += vec2(n.x>=0.0 ? -t : t,n.y>=0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
 
-    p   = position;
+    p   = meshCenter+meshRadius*position;
     p.x -= 25*_y;
     p.y += 10*sin(_y);
 
-    gl_Position = projMat*mdvMat*vec4(p,1);
-    normalView  = normalize(normalMat*normal);
-    eyeView     = normalize((mdvMat*vec4(p,1.0)).xyz);
+    mat4 mdv = cloudMat*model;
+
+    gl_Position = projMat*mdv*vec4(p,1);
+    normalView  = normalize(normalMat*octDecode(normal));
+    eyeView     = normalize((mdv*vec4(p,1.0)).xyz);
 
 }
@@ -0,0 +1,12 @@
+// per-frame data shared by all the programs (std140, see
+// Viewer::FrameData, bound to point 0 by Viewer::createShaders)
+layout(std140) uniform FrameData {
+  mat4  mdvMat;    // modelview matrix
+  mat4  projMat;   // projection matrix
+  mat3  normalMat; // normal matrix
+  vec3  light;
+  float _y;
+  vec3  motion;
+  float _t;
+  mat4  cloudMat;  // modelview matrix of the clouds
+};
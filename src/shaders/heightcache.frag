@@ -0,0 +1,20 @@
+#version 330
+
+// input uniforms
+uniform vec4 rows;      // x: xmin, y: x step, z: y of the first row, w: y step
+uniform float texFirst; // texture row of the first row
+uniform float _y;       // always 0 here: the rows are given in world space
+
+// out buffers
+layout(location = 0) out vec4 outHeight;
+
+#include "terrainHeight.glsl"
+
+void main() {
+  vec2 texel = floor(gl_FragCoord.xy);
+  vec2 p = vec2(rows.x + texel.x*rows.y,
+                rows.z + (texel.y-texFirst)*rows.w);
+
+  // normal (xyz) and height (w) of the terrain
+  outHeight = vec4(computeNormal(p),computeHeight(p));
+}
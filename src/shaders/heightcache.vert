@@ -0,0 +1,8 @@
+#version 330
+
+// full screen triangle (no vertex buffer): the viewport selects
+// the rows of the height cache that are updated
+void main() {
+  vec2 p = vec2((gl_VertexID<<1)&2, gl_VertexID&2);
+  gl_Position = vec4(p*2.-1.,0.,1.);
+}
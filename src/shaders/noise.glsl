@@ -0,0 +1,41 @@
+// gradient noise shared by the terrain and water shaders (included by
+// Shader, see Shader::define for the permutations)
+
+// octaves of pnoise: a compile-time constant, so that the compiler
+// unrolls the loop and folds the amplitudes and frequencies of each call
+#ifndef NOISE_OCTAVES
+#define NOISE_OCTAVES 2
+#endif
+
+// fonctions utiles pour créer des terrains en général
+vec2 hash(vec2 p) {
+  p = vec2( dot(p,vec2(127.1,311.7)),
+	    dot(p,vec2(269.5,183.3)) );  
+  return -1.0 + 2.0*fract(sin(p)*43758.5453123);
+}
+
+float gnoise(in vec2 p) {
+  vec2 i = floor(p);
+  vec2 f = fract(p);
+	
+  vec2 u = f*f*(3.0-2.0*f);
+  
+  return mix(mix(dot(hash(i+vec2(0.0,0.0)),f-vec2(0.0,0.0)), 
+		 dot(hash(i+vec2(1.0,0.0)),f-vec2(1.0,0.0)),u.x),
+	     mix(dot(hash(i+vec2(0.0,1.0)),f-vec2(0.0,1.0)), 
+		 dot(hash(i+vec2(1.0,1.0)),f-vec2(1.0,1.0)),u.x),u.y);
+}
+
+float pnoise(in vec2 p,in float amplitude,in float frequency,in float persistence) {
+  float a = amplitude;
+  float f = frequency;
+  float n = 0.0;
+  
+  for(int i=0;i<NOISE_OCTAVES;++i) {
+    n = n+a*gnoise(p*f);
+    f = f*2.;
+    a = a*persistence;
+  }
+  
+  return n;
+}
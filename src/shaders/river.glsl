@@ -0,0 +1,6 @@
+// horizontal offset of the river bed at world y = t
+float riverFlow(float t){
+//  return .5*sin(t*3);
+  float l = .2;
+  return .5*sin(t*3*l) + .2*sin(t*8*l) + 2*sin(t*0.2*l);
+}
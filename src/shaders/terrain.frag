@@ -1,8 +1,7 @@
 #version 330
 
 // input uniforms 
-uniform vec3 light;
-uniform vec3 motion;
+#include "frameData.glsl"
 uniform sampler2D grassmap;
 uniform sampler2D gravelmap;
 
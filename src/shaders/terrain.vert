@@ -1,16 +1,18 @@
 #version 330
 
 // input attributes 
-layout(location = 0) in vec3 position; 
+layout(location = 0) in vec2 position; // column and row in the grid
 
 // input uniforms
-uniform mat4 mdvMat;      // modelview matrix 
-uniform mat4 projMat;     // projection matrix
-uniform mat3 normalMat;   // normal matrix
-uniform vec3 light;
-uniform vec3 motion;
-uniform float _y;
-uniform float _t;
+#include "frameData.glsl"
+uniform vec2 grid;      // origin (x) and step (y) of the grid
+uniform vec3 tile;      // patch offset (xy) and scale (z)
+uniform vec4 morph;     // LOD morph start/end distances (xy), patch cells (z, 0: off)
+uniform vec3 camPos;    // camera position in terrain space
+uniform float clipmap;  // clipmap grid cells (0: off)
+uniform sampler2D heightCache; // cached normals (xyz) and heights (w)
+uniform vec4 cacheArea; // cached area in terrain space: xmin,xmax,ymin,ymax
+uniform vec4 cacheStep; // texel spacing (xy) and texture size (zw)
 
 // out variables 
 out vec3 normalView;
@@ -18,122 +20,71 @@ out vec3 eyeView;
 out float px;
 out vec2 uvcoord;
 
-// fonctions utiles pour créer des terrains en général
-vec2 hash(vec2 p) {
-  p = vec2( dot(p,vec2(127.1,311.7)),
-	    dot(p,vec2(269.5,183.3)) );  
-  return -1.0 + 2.0*fract(sin(p)*43758.5453123);
-}
+#include "river.glsl"
+#include "terrainHeight.glsl"
 
-float gnoise(in vec2 p) {
-  vec2 i = floor(p);
-  vec2 f = fract(p);
-	
-  vec2 u = f*f*(3.0-2.0*f);
-  
-  return mix(mix(dot(hash(i+vec2(0.0,0.0)),f-vec2(0.0,0.0)), 
-		 dot(hash(i+vec2(1.0,0.0)),f-vec2(1.0,0.0)),u.x),
-	     mix(dot(hash(i+vec2(0.0,1.0)),f-vec2(0.0,1.0)), 
-		 dot(hash(i+vec2(1.0,1.0)),f-vec2(1.0,1.0)),u.x),u.y);
+// position of the vertex in the grid
+vec2 gridPosition() {
+  return grid.x + grid.y*position;
 }
 
-float pnoise(in vec2 p,in float amplitude,in float frequency,in float persistence, in int nboctaves) {
-  float a = amplitude;
-  float f = frequency;
-  float n = 0.0;
-  
-  for(int i=0;i<nboctaves;++i) {
-    n = n+a*gnoise(p*f);
-    f = f*2.;
-    a = a*persistence;
+// position of the vertex in terrain space
+vec2 tilePosition() {
+  vec2 g = gridPosition();
+
+  // clipmap: the odd vertices of the border of a level are snapped onto
+  // the even ones, which are shared with the next (coarser) level
+  if(clipmap>0.) {
+    if(g.y==0. || g.y==clipmap) g.x -= mod(g.x,2.);
+    if(g.x==0. || g.x==clipmap) g.y -= mod(g.y,2.);
   }
-  
-  return n;
-}
 
-float riverFLow(float t){
-//  return .5*sin(t*3);
-  float l = .2;
-  return .5*sin(t*3*l) + .2*sin(t*8*l) + 2*sin(t*0.2*l);
+  return tile.xy + tile.z*g;
 }
 
-float computeHeight(in vec2 p) {
-  float height;
-  float height_micro;
-  float height1;
-  float height2;
-  float height3;
-  float height_river;
-  // grandes variations
-  // rive gauche
-  vec2 point = vec2(p.x, p.y + _y);
-  height = pnoise(point,.25,1.1,.05,2);
-  height += 0.04;
-//  height_micro = pnoise(point,.005,3,7.05,2);
-  height_micro = pnoise(point,.004,50,.005,2);
-  height1 = height + height_micro;
-  //rive droite
-  height = pnoise(point,.1 ,3,.05,2);
-  height_micro = pnoise(point,.004,50,.005,2);
-  height3 = height + height_micro;
-  // lit de la rivière
-  float offset = -(3.1415)/2.;
-  float periode = 10;
-  // variation de la largeur
-  periode + 3*(sin((_y+ p.y)*3) + 0.3*sin((_y+ p.y)*10));
-  float max_height = 0;
-  float sin_height = .2;
-  // calculation
-  float sin_val = sin_height*sin(offset + p.x * periode);
-  height = sin_val;
-  height = min(0., height);
-  height = max(-.12, height);
-  height_river = height;
+// CDLOD geomorphing: odd vertices slide onto the coarser grid
+// when the patch gets close to the end of its LOD range
+vec2 morphPosition(in vec2 p) {
+  if(morph.z<=0.) return p;
 
-  // smoothstep between tiers
-  float v = .1;
-  float off = .23;
-  if (p.x < 0) {
-    float frontiere = -1./3. + off;
-    float s = smoothstep(frontiere-v, frontiere+v, p.x);
-    height = mix(height1, height_river, s);
-    return height;
-  } if (p.x > 0){
-    float frontiere = 1./3. - off;
-    float s = smoothstep(frontiere-v, frontiere+v, p.x);
-    height = mix(height_river,height3, s);
-    return height;
-  }
-  return height_river;
+  float d = distance(vec3(p,0.),camPos);
+  float k = clamp((d-morph.x)/(morph.y-morph.x),0.,1.);
+  vec2  g = floor(gridPosition()*morph.z+.5);
+  return p - mod(g,2.)*(tile.z/morph.z)*k;
 }
 
+bool inHeightCache(in vec2 p) {
+  return p.x>=cacheArea.x && p.x<=cacheArea.y && p.y>=cacheArea.z && p.y<=cacheArea.w;
+}
 
-vec3 computeNormal(in vec2 p) {
-  const float EPS = 0.01;
-  const float SCALE = 1.;
-  
-  vec2 g = vec2(computeHeight(p+vec2(EPS,0.))-computeHeight(p-vec2(EPS,0.)),
-		computeHeight(p+vec2(0.,EPS))-computeHeight(p-vec2(0.,EPS)))/(2.*EPS);
-  
-  vec3 n1 = vec3(1.,0.,g.x*SCALE);
-  vec3 n2 = vec3(0.,1.,-g.y*SCALE);
-  vec3 n = normalize(cross(n1,n2));
-
-  return n;
+// the rows of the cache are a ring buffer indexed by the world y
+vec4 fetchHeightCache(in vec2 p) {
+  float u = ((p.x-cacheArea.x)/cacheStep.x + .5)/cacheStep.z;
+  float v = mod((p.y+_y)/cacheStep.y + .5,cacheStep.w)/cacheStep.w;
+  return textureLod(heightCache,vec2(u,v),0.);
 }
 
 void main() {
-  px = position.x;
-  float h = computeHeight(position.xy);
-  vec3  n = computeNormal(position.xy);
+  vec2 pos = morphPosition(tilePosition());
+  px = pos.x;
+  float h;
+  vec3  n;
+  if(inHeightCache(pos)) {
+    vec4 c = fetchHeightCache(pos);
+    h = c.w;
+    n = normalize(c.xyz);
+  } else {
+    h = computeHeight(pos);
+    n = computeNormal(pos);
+  }
 
 //  float x = position.x + .5*sin(motion.x*10 +(_y + position.y)*3);
-  float x = position.x + riverFLow(_y + position.y);
-  vec3 p = vec3(x, position.y,h);
+  float x = pos.x + riverFlow(_y + pos.y);
+  vec3 p = vec3(x, pos.y,h);
 
   
   gl_Position =  projMat*mdvMat*vec4(p,1);
   normalView  = normalize(normalMat*n);
   eyeView     = normalize((mdvMat*vec4(p,1.0)).xyz);
-  uvcoord = vec2(position.x, position.y + _y)  * 5.;
+  uvcoord = vec2(pos.x, pos.y + _y)  * 5.;
 }
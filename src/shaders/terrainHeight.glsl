@@ -0,0 +1,68 @@
+// height and normal of the terrain at p (terrain space, scrolled by _y,
+// which the including shader declares)
+#include "noise.glsl"
+
+float computeHeight(in vec2 p) {
+  float height;
+  float height_micro;
+  float height1;
+  float height2;
+  float height3;
+  float height_river;
+  // grandes variations
+  // rive gauche
+  vec2 point = vec2(p.x, p.y + _y);
+  height = pnoise(point,.25,1.1,.05);
+  height += 0.04;
+//  height_micro = pnoise(point,.005,3,7.05);
+  height_micro = pnoise(point,.004,50,.005);
+  height1 = height + height_micro;
+  //rive droite
+  height = pnoise(point,.1 ,3,.05);
+  height_micro = pnoise(point,.004,50,.005);
+  height3 = height + height_micro;
+  // lit de la rivière
+  float offset = -(3.1415)/2.;
+  float periode = 10;
+  // variation de la largeur
+  periode + 3*(sin((_y+ p.y)*3) + 0.3*sin((_y+ p.y)*10));
+  float max_height = 0;
+  float sin_height = .2;
+  // calculation
+  float sin_val = sin_height*sin(offset + p.x * periode);
+  height = sin_val;
+  height = min(0., height);
+  height = max(-.12, height);
+  height_river = height;
+
+  // smoothstep between tiers
+  float v = .1;
+  float off = .23;
+  if (p.x < 0) {
+    float frontiere = -1./3. + off;
+    float s = smoothstep(frontiere-v, frontiere+v, p.x);
+    height = mix(height1, height_river, s);
+    return height;
+  } if (p.x > 0){
+    float frontiere = 1./3. - off;
+    float s = smoothstep(frontiere-v, frontiere+v, p.x);
+    height = mix(height_river,height3, s);
+    return height;
+  }
+  return height_river;
+}
+
+
+vec3 computeNormal(in vec2 p) {
+  const float EPS = 0.01;
+  const float SCALE = 1.;
+  
+  vec2 g = vec2(computeHeight(p+vec2(EPS,0.))-computeHeight(p-vec2(EPS,0.)),
+		computeHeight(p+vec2(0.,EPS))-computeHeight(p-vec2(0.,EPS)))/(2.*EPS);
+  
+  vec3 n1 = vec3(1.,0.,g.x*SCALE);
+  vec3 n2 = vec3(0.,1.,-g.y*SCALE);
+  vec3 n = normalize(cross(n1,n2));
+
+  return n;
+}
@@ -0,0 +1,17 @@
+#version 400
+
+// input attributes
+layout(location = 0) in vec2 position; // column and row in the grid
+
+// input uniforms
+uniform vec2 grid;      // origin (x) and step (y) of the grid
+uniform vec3 tile;      // patch offset (xy) and scale (z)
+
+// out variables
+out vec2 tcPosition;
+
+// the coarse grid is only placed here: heights are computed
+// after tessellation (terrain.tese)
+void main() {
+  tcPosition = tile.xy + tile.z*(grid.x + grid.y*position);
+}
@@ -1,17 +1,16 @@
 #version 330
 
 // input attributes 
-layout(location = 0) in vec3 position;
+layout(location = 0) in vec2 position; // column and row in the grid
 
 // input uniforms
-uniform mat4 mdvMat;      // modelview matrix 
-uniform mat4 projMat;     // projection matrix
-uniform mat3 normalMat;   // normal matrix
-uniform vec3 light;
-uniform vec3 motion;
-uniform float _y;
+#include "frameData.glsl"
 uniform float clock;
-uniform float _t;
+uniform vec2 grid;      // origin (x) and step (y) of the grid
+uniform vec3 tile;      // patch offset (xy) and scale (z)
+uniform vec4 morph;     // LOD morph start/end distances (xy), patch cells (z, 0: off)
+uniform vec3 camPos;    // camera position in terrain space
+uniform float clipmap;  // clipmap grid cells (0: off)
 
 // out variables 
 out vec3 normalView;
@@ -19,44 +18,8 @@ out vec3 eyeView;
 out float px;
 out float py;
 
-// fonctions utiles pour créer des terrains en général
-vec2 hash(vec2 p) {
-  p = vec2( dot(p,vec2(127.1,311.7)),
-            dot(p,vec2(269.5,183.3)) );
-  return -1.0 + 2.0*fract(sin(p)*43758.5453123);
-}
-
-float gnoise(in vec2 p) {
-  vec2 i = floor(p);
-  vec2 f = fract(p);
-
-  vec2 u = f*f*(3.0-2.0*f);
-
-  return mix(mix(dot(hash(i+vec2(0.0,0.0)),f-vec2(0.0,0.0)),
-                 dot(hash(i+vec2(1.0,0.0)),f-vec2(1.0,0.0)),u.x),
-             mix(dot(hash(i+vec2(0.0,1.0)),f-vec2(0.0,1.0)),
-                 dot(hash(i+vec2(1.0,1.0)),f-vec2(1.0,1.0)),u.x),u.y);
-}
-
-float pnoise(in vec2 p,in float amplitude,in float frequency,in float persistence, in int nboctaves) {
-  float a = amplitude;
-  float f = frequency;
-  float n = 0.0;
-
-  for(int i=0;i<nboctaves;++i) {
-    n = n+a*gnoise(p*f);
-    f = f*2.;
-    a = a*persistence;
-  }
-
-  return n;
-}
-
-float riverFLow(float t){
-  //  return .5*sin(t*3);
-  float l = .2;
-  return .5*sin(t*3*l) + .2*sin(t*8*l) + 2*sin(t*0.2*l);
-}
+#include "noise.glsl"
+#include "river.glsl"
 
 float computeHeight(in vec2 p) {
   float larg = 0.16;
@@ -70,13 +33,13 @@ float computeHeight(in vec2 p) {
   vec2 point = vec2(p.x, p.y + _y + _t * 0.1);
   point = vec2(p.x , p.y + _y + _t * 0.001);
   float ampl = 0.05;
-  float noiseA = pnoise(point, ampl, 40,.005,2);
-  float noiseB = pnoise(point + vec2(0.5, 0.5), ampl, 40,.005,2);
+  float noiseA = pnoise(point, ampl, 40,.005);
+  float noiseB = pnoise(point + vec2(0.5, 0.5), ampl, 40,.005);
   float w = _t *20.;
   float pi = 4.1315;
   float noise = sin(w)*noiseA + sin(-w-pi/2)*noiseB;
   point = vec2(p.x , p.y + _y + _t *  2.);
-//  float noise = pnoise(point,.25,10,1.005,2);
+//  float noise = pnoise(point,.25,10,1.005);
   float waves = gnoise(point*2. );
 //  waves = 0;
   return base + noise*0.1 + waves*0.03 ;
@@ -97,15 +60,46 @@ vec3 computeNormal(in vec2 p) {
   return n;
 }
 
+// position of the vertex in the grid
+vec2 gridPosition() {
+  return grid.x + grid.y*position;
+}
+
+// position of the vertex in terrain space
+vec2 tilePosition() {
+  vec2 g = gridPosition();
+
+  // clipmap: the odd vertices of the border of a level are snapped onto
+  // the even ones, which are shared with the next (coarser) level
+  if(clipmap>0.) {
+    if(g.y==0. || g.y==clipmap) g.x -= mod(g.x,2.);
+    if(g.x==0. || g.x==clipmap) g.y -= mod(g.y,2.);
+  }
+
+  return tile.xy + tile.z*g;
+}
+
+// CDLOD geomorphing: odd vertices slide onto the coarser grid
+// when the patch gets close to the end of its LOD range
+vec2 morphPosition(in vec2 p) {
+  if(morph.z<=0.) return p;
+
+  float d = distance(vec3(p,0.),camPos);
+  float k = clamp((d-morph.x)/(morph.y-morph.x),0.,1.);
+  vec2  g = floor(gridPosition()*morph.z+.5);
+  return p - mod(g,2.)*(tile.z/morph.z)*k;
+}
+
 void main() {
-  px = position.x;
-  py = position.y;
-  float h =  computeHeight(position.xy);
-  vec3  n = computeNormal(position.xy);
+  vec2 pos = morphPosition(tilePosition());
+  px = pos.x;
+  py = pos.y;
+  float h =  computeHeight(pos);
+  vec3  n = computeNormal(pos);
 
   //  float x = position.x + .5*sin(motion.x*10 +(_y + position.y)*3);
-  float x = position.x + riverFLow(_y + position.y);
-  vec3 p = vec3(x, position.y,h);
+  float x = pos.x + riverFlow(_y + pos.y);
+  vec3 p = vec3(x, pos.y,h);
 //  vec3 p = vec3(x, position.y,h) + _t * 0.0001;
 
 
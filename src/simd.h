@@ -0,0 +1,114 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Small wrappers around one float and SIMD registers: computations are
+// written once as templates on these types, FN being the widest one
+// available. Only IEEE operations and selects: every width computes
+// exactly the same values.
+namespace simd {
+
+struct F1 {
+  static const unsigned int width = 1;
+  float v;
+
+  F1() {}
+  F1(float a) : v(a) {}
+
+  static F1   load (const float *p) {return F1(*p);}
+  inline void store(float *p) const {*p = v;}
+};
+
+inline F1 operator+(F1 a,F1 b) {return F1(a.v+b.v);}
+inline F1 operator-(F1 a,F1 b) {return F1(a.v-b.v);}
+inline F1 operator*(F1 a,F1 b) {return F1(a.v*b.v);}
+inline F1 operator/(F1 a,F1 b) {return F1(a.v/b.v);}
+inline F1 vfloor(F1 a)         {return F1(floorf(a.v));}
+inline F1 vabs  (F1 a)         {return F1(fabsf(a.v));}
+inline F1 vmin  (F1 a,F1 b)    {return F1(b.v<a.v ? b.v : a.v);}
+inline F1 vmax  (F1 a,F1 b)    {return F1(a.v<b.v ? b.v : a.v);}
+inline F1 vsqrt (F1 a)         {return F1(sqrtf(a.v));}
+// a<b ? c : d
+inline F1 vselectLess(F1 a,F1 b,F1 c,F1 d) {return a.v<b.v ? c : d;}
+
+#if defined(__AVX2__)
+
+struct F8 {
+  static const unsigned int width = 8;
+  __m256 v;
+
+  F8() {}
+  F8(__m256 a) : v(a) {}
+  F8(float a)  : v(_mm256_set1_ps(a)) {}
+
+  static F8   load (const float *p) {return F8(_mm256_loadu_ps(p));}
+  inline void store(float *p) const {_mm256_storeu_ps(p,v);}
+};
+
+inline F8 operator+(F8 a,F8 b) {return F8(_mm256_add_ps(a.v,b.v));}
+inline F8 operator-(F8 a,F8 b) {return F8(_mm256_sub_ps(a.v,b.v));}
+inline F8 operator*(F8 a,F8 b) {return F8(_mm256_mul_ps(a.v,b.v));}
+inline F8 operator/(F8 a,F8 b) {return F8(_mm256_div_ps(a.v,b.v));}
+inline F8 vfloor(F8 a)         {return F8(_mm256_floor_ps(a.v));}
+inline F8 vabs  (F8 a)         {return F8(_mm256_andnot_ps(_mm256_set1_ps(-0.0f),a.v));}
+inline F8 vmin  (F8 a,F8 b)    {return F8(_mm256_min_ps(a.v,b.v));}
+inline F8 vmax  (F8 a,F8 b)    {return F8(_mm256_max_ps(a.v,b.v));}
+inline F8 vsqrt (F8 a)         {return F8(_mm256_sqrt_ps(a.v));}
+inline F8 vselectLess(F8 a,F8 b,F8 c,F8 d) {
+  return F8(_mm256_blendv_ps(d.v,c.v,_mm256_cmp_ps(a.v,b.v,_CMP_LT_OQ)));
+}
+
+typedef F8 FN;
+
+#elif defined(__SSE2__)
+
+struct F4 {
+  static const unsigned int width = 4;
+  __m128 v;
+
+  F4() {}
+  F4(__m128 a) : v(a) {}
+  F4(float a)  : v(_mm_set1_ps(a)) {}
+
+  static F4   load (const float *p) {return F4(_mm_loadu_ps(p));}
+  inline void store(float *p) const {_mm_storeu_ps(p,v);}
+};
+
+inline F4 operator+(F4 a,F4 b) {return F4(_mm_add_ps(a.v,b.v));}
+inline F4 operator-(F4 a,F4 b) {return F4(_mm_sub_ps(a.v,b.v));}
+inline F4 operator*(F4 a,F4 b) {return F4(_mm_mul_ps(a.v,b.v));}
+inline F4 operator/(F4 a,F4 b) {return F4(_mm_div_ps(a.v,b.v));}
+inline F4 vabs  (F4 a)         {return F4(_mm_andnot_ps(_mm_set1_ps(-0.0f),a.v));}
+inline F4 vmin  (F4 a,F4 b)    {return F4(_mm_min_ps(a.v,b.v));}
+inline F4 vmax  (F4 a,F4 b)    {return F4(_mm_max_ps(a.v,b.v));}
+inline F4 vsqrt (F4 a)         {return F4(_mm_sqrt_ps(a.v));}
+inline F4 vselectLess(F4 a,F4 b,F4 c,F4 d) {
+  const __m128 m = _mm_cmplt_ps(a.v,b.v);
+  return F4(_mm_or_ps(_mm_and_ps(m,c.v),_mm_andnot_ps(m,d.v)));
+}
+inline F4 vfloor(F4 a) {
+  // no SSE2 floor: truncate, fix negative values, keep the large
+  // values (already integers, out of the int range)
+  const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+  const __m128 f = _mm_sub_ps(t,_mm_and_ps(_mm_cmpgt_ps(t,a.v),_mm_set1_ps(1.0f)));
+  return vselectLess(vabs(a),F4(8388608.0f),F4(f),a);
+}
+
+typedef F4 FN;
+
+#else
+
+typedef F1 FN;
+
+#endif
+
+} // namespace simd
+
+#endif // SIMD_H
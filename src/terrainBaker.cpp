@@ -0,0 +1,122 @@
+#include "terrainBaker.h"
+#include "terrainFunction.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// write all the bytes at the given offset of the file
+static bool writeAt(int fd,const void *data,size_t size,off_t offset) {
+  const char *p = (const char *)data;
+  while(size>0) {
+    const ssize_t n = pwrite(fd,p,size,offset);
+    if(n<=0)
+      return false;
+    p      += n;
+    size   -= (size_t)n;
+    offset += n;
+  }
+  return true;
+}
+
+// create the file with its PFM header, sized for all the samples
+static int createPfm(const string &file,const char *type,unsigned int width,unsigned int height,
+		     unsigned int channels,long &header) {
+  char text[64];
+  snprintf(text,sizeof(text),"%s\n%u %u\n-1.0\n",type,width,height); // little endian
+  header = (long)strlen(text);
+
+  const int fd = open(file.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+  if(fd<0)
+    return -1;
+
+  const off_t size = (off_t)header+(off_t)width*height*channels*sizeof(float);
+  if(!writeAt(fd,text,header,0) || ftruncate(fd,size)!=0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+TerrainBaker::TerrainBaker(unsigned int width,unsigned int height,
+			   float xmin,float xmax,float ymin,float ymax,
+			   unsigned int tileSize)
+  : _width(width),
+    _height(height),
+    _xmin(xmin),
+    _xstep((xmax-xmin)/(float)width),
+    _ymin(ymin),
+    _ystep((ymax-ymin)/(float)height),
+    _tileSize(tileSize),
+    _nbTilesX((width+tileSize-1)/tileSize),
+    _nbTilesY((height+tileSize-1)/tileSize),
+    _error(false) {
+
+}
+
+void TerrainBaker::bakeTile(unsigned int tile,int heightFd,int normalFd,long heightHeader,long normalHeader) {
+  const unsigned int x0 = (tile%_nbTilesX)*_tileSize;
+  const unsigned int y0 = (tile/_nbTilesX)*_tileSize;
+  const unsigned int w  = min(_tileSize,_width -x0);
+  const unsigned int h  = min(_tileSize,_height-y0);
+  const unsigned int nb = w*h;
+
+  vector<float> xs(nb),ys(nb),heights(nb),normals(3*nb);
+  for(unsigned int i=0;i<h;++i) {
+    for(unsigned int j=0;j<w;++j) {
+      xs[i*w+j] = _xmin+_xstep*(float)(x0+j);
+      ys[i*w+j] = _ymin+_ystep*(float)(y0+i);
+    }
+  }
+
+  TerrainFunction::heights(&xs[0],&ys[0],&heights[0],nb);
+  TerrainFunction::normals(&xs[0],&ys[0],&normals[0],nb);
+
+  // each row of the tile goes at its place in the files
+  for(unsigned int i=0;i<h;++i) {
+    const off_t sample = (off_t)(y0+i)*_width+x0;
+    if(!writeAt(heightFd,&heights[i*w],w*sizeof(float),heightHeader+sample*sizeof(float)) ||
+       !writeAt(normalFd,&normals[3*i*w],3*w*sizeof(float),normalHeader+3*sample*sizeof(float))) {
+      _error = true;
+      return;
+    }
+  }
+}
+
+bool TerrainBaker::bake(const string &heightFile,const string &normalFile,ThreadPool &pool) {
+  long heightHeader,normalHeader;
+  const int heightFd = createPfm(heightFile,"Pf",_width,_height,1,heightHeader);
+  const int normalFd = createPfm(normalFile,"PF",_width,_height,3,normalHeader);
+
+  if(heightFd<0 || normalFd<0) {
+    cout << "Unable to write " << (heightFd<0 ? heightFile : normalFile) << endl;
+    if(heightFd>=0) close(heightFd);
+    if(normalFd>=0) close(normalFd);
+    return false;
+  }
+
+  cout << "Baking " << _width << "x" << _height << " samples (" << _nbTilesX*_nbTilesY
+       << " tiles, " << pool.nbThreads() << " threads, " << TerrainFunction::simdName() << ")" << endl;
+
+  _error = false;
+  pool.parallelFor(0,_nbTilesX*_nbTilesY,1,[&](unsigned int first,unsigned int last) {
+      for(unsigned int t=first;t<last;++t)
+	bakeTile(t,heightFd,normalFd,heightHeader,normalHeader);
+    });
+
+  close(heightFd);
+  close(normalFd);
+
+  if(_error) {
+    cout << "Unable to write " << heightFile << " / " << normalFile << endl;
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,38 @@
+#ifndef TERRAIN_BAKER_H
+#define TERRAIN_BAKER_H
+
+#include <atomic>
+#include <string>
+
+#include "threadPool.h"
+
+// Offline evaluation of the terrain (TerrainFunction) on a regular grid
+// of width x height samples covering [xmin,xmax)x[ymin,ymax) in world
+// space. The maps are split into square tiles computed by a thread pool
+// and written in place into two PFM files (heights: "Pf", 1 float per
+// sample, normals: "PF", 3 floats per sample), first row at ymin.
+class TerrainBaker {
+ public:
+  TerrainBaker(unsigned int width,unsigned int height,
+	       float xmin=-1.0f,float xmax=1.0f,float ymin=-1.0f,float ymax=1.0f,
+	       unsigned int tileSize=256);
+
+  // false if one of the files could not be written
+  bool bake(const std::string &heightFile,const std::string &normalFile,ThreadPool &pool);
+
+ private:
+  void bakeTile(unsigned int tile,int heightFd,int normalFd,long heightHeader,long normalHeader);
+
+  unsigned int _width;
+  unsigned int _height;
+  float        _xmin;
+  float        _xstep;
+  float        _ymin;
+  float        _ystep;
+  unsigned int _tileSize;
+  unsigned int _nbTilesX;
+  unsigned int _nbTilesY;
+  std::atomic<bool> _error;
+};
+
+#endif // TERRAIN_BAKER_H
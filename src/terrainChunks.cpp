@@ -0,0 +1,92 @@
+#include "terrainChunks.h"
+
+#include <math.h>
+
+using namespace std;
+
+TerrainChunks::TerrainChunks(unsigned int resol,float chunkSize,
+			     float xmin,float xmax,float ystart,
+			     unsigned int nbAhead,unsigned int nbBehind)
+  : _chunkSize(chunkSize),
+    _xmin(xmin),
+    _ystart(ystart),
+    _nbCols((unsigned int)ceil((xmax-xmin)/chunkSize)),
+    _nbRows(nbAhead+nbBehind),
+    _nbBehind(nbBehind),
+    _firstRow(0),
+    _nbRecycled(0),
+    _vao(0) {
+
+  // Grid spans [min,max-step]: choose max so that the last vertex lies
+  // exactly on 1 and neighbouring chunks share their border vertices
+  _grid = new Grid(resol,0.0f,(float)resol/(float)(resol-1),0,Grid::STRIPS);
+
+  _chunks.resize(_nbRows*_nbCols);
+  for(unsigned int i=0;i<_nbRows;++i) {
+    setRow(i,(int)i);
+  }
+  _nbRecycled = 0;
+}
+
+TerrainChunks::~TerrainChunks() {
+  delete _grid;
+}
+
+void TerrainChunks::createVAO() {
+  glGenBuffers(2,_buffers);
+  glGenVertexArrays(1,&_vao);
+
+  // one shared grid for all the chunks
+  glBindVertexArray(_vao);
+  _grid->upload(_buffers[0],_buffers[1]); // vertices, indices
+  glBindVertexArray(0);
+}
+
+void TerrainChunks::deleteVAO() {
+  glDeleteBuffers(2,_buffers);
+  glDeleteVertexArrays(1,&_vao);
+}
+
+void TerrainChunks::setRow(unsigned int slot,int row) {
+  for(unsigned int j=0;j<_nbCols;++j) {
+    Chunk &c = _chunks[slot*_nbCols+j];
+    c.row = row;
+    c.col = (int)j;
+    c.x   = _xmin+_chunkSize*(float)j;
+    c.y   = _chunkSize*(float)row;
+  }
+  _nbRecycled += _nbCols;
+}
+
+void TerrainChunks::update(float y) {
+  // first row needed: the one under the start of the terrain
+  _firstRow = (int)floor((y+_ystart)/_chunkSize)-(int)_nbBehind;
+
+  for(unsigned int i=0;i<_nbRows;++i) {
+    const int row = _firstRow+(int)i;
+    const unsigned int slot = (unsigned int)(((row%(int)_nbRows)+(int)_nbRows)%(int)_nbRows);
+
+    // this slot still holds an old row: recycle it
+    if(_chunks[slot*_nbCols].row!=row)
+      setRow(slot,row);
+  }
+}
+
+void TerrainChunks::draw(const Shader *shader,float y) {
+  const GLint tileLoc = shader->uniform("tile");
+
+  _grid->setUniform(shader);
+  glBindVertexArray(_vao);
+  // rows are sent from the camera to the horizon (helps early depth test)
+  for(unsigned int i=0;i<_nbRows;++i) {
+    const int row = _firstRow+(int)i;
+    const unsigned int slot = (unsigned int)(((row%(int)_nbRows)+(int)_nbRows)%(int)_nbRows);
+
+    for(unsigned int j=0;j<_nbCols;++j) {
+      const Chunk &c = _chunks[slot*_nbCols+j];
+      glUniform3f(tileLoc,c.x,c.y-y,_chunkSize);
+      _grid->draw();
+    }
+  }
+  glBindVertexArray(0);
+}
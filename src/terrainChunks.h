@@ -0,0 +1,64 @@
+#ifndef TERRAIN_CHUNKS_H
+#define TERRAIN_CHUNKS_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "grid.h"
+#include "shader.h"
+
+// Terrain split into fixed-size square chunks. All chunks share the same
+// Grid (built once on [0,1]x[0,1]) and are placed with the "tile" uniform
+// of the terrain/water shaders. Chunks are organised in a ring of rows:
+// when the scrolling offset _y moves forward, the rows left behind the
+// camera are recycled as new rows ahead of it.
+class TerrainChunks {
+ public:
+  TerrainChunks(unsigned int resol=129,float chunkSize=0.5f,
+		float xmin=-1.0f,float xmax=1.0f,float ystart=-1.0f,
+		unsigned int nbAhead=4,unsigned int nbBehind=0);
+  ~TerrainChunks();
+
+  // GPU objects (need a current OpenGL context)
+  void createVAO();
+  void deleteVAO();
+
+  // recycle the rows that are not needed anymore for offset y
+  void update(float y);
+
+  // draw all the active chunks with the given program (near to far)
+  void draw(const Shader *shader,float y);
+
+  inline unsigned int nbChunks  () const {return (unsigned int)_chunks.size();}
+  inline unsigned int nbRecycled() const {return _nbRecycled;}
+  inline float        chunkSize () const {return _chunkSize;}
+
+ private:
+  struct Chunk {
+    int   row;   // row index along y (in chunk units, world space)
+    int   col;   // column index along x
+    float x;     // lower left corner (terrain space)
+    float y;     // lower left corner (world space, i.e. before the _y scroll)
+  };
+
+  void setRow(unsigned int slot,int row);
+
+  Grid *_grid;
+
+  float        _chunkSize;
+  float        _xmin;
+  float        _ystart;
+  unsigned int _nbCols;
+  unsigned int _nbRows;
+  unsigned int _nbBehind;
+
+  // ring of rows: chunk (row,col) lives in slot (row mod _nbRows)*_nbCols+col
+  std::vector<Chunk> _chunks;
+  int                _firstRow;
+  unsigned int       _nbRecycled;
+
+  GLuint _vao;
+  GLuint _buffers[2];
+};
+
+#endif // TERRAIN_CHUNKS_H
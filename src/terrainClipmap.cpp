@@ -0,0 +1,119 @@
+#include "terrainClipmap.h"
+
+#include <math.h>
+
+using namespace std;
+
+// positive modulo
+static double pmod(double a,double b) {
+  return a-floor(a/b)*b;
+}
+
+TerrainClipmap::TerrainClipmap(unsigned int cells,unsigned int nbLevels,
+			       float spacing,float ycenter)
+  : _cells(cells),
+    _vao(0) {
+
+  // integer coordinates 0..cells, cells row by row (for the rings)
+  _grid = new Grid(cells+1,0.0f,(float)(cells+1),0,Grid::ROWS);
+
+  // the center must lie on the vertices of every level
+  const float coarsest = spacing*(float)(1<<(nbLevels-1));
+  _center = floor(ycenter/coarsest+0.5f)*coarsest;
+
+  _levels.resize(nbLevels);
+  for(unsigned int l=0;l<nbLevels;++l) {
+    _levels[l].spacing = spacing*(float)(1<<l);
+    _levels[l].hole    = 0;
+  }
+
+  // the finest level is the whole grid
+  vector<int> faces(_grid->nbIndices());
+  _grid->fillFaces(&faces[0]);
+  _indices = faces;
+  _nbFull = (unsigned int)_indices.size();
+
+  // rings: same grid without the cells covered by the finer level. Faces
+  // are emitted two triangles per cell, row by row (see Grid::Grid)
+  const unsigned int q = cells/4;
+  for(int d=0;d<2;++d) {
+    _firstRing[d] = (unsigned int)_indices.size();
+    for(unsigned int c=0;c<cells*cells;++c) {
+      const unsigned int cx = c%cells;
+      const unsigned int cy = c/cells;
+      if(cx>=q && cx<3*q && cy>=q+d && cy<3*q+d)
+	continue;
+      _indices.insert(_indices.end(),faces.begin()+6*c,faces.begin()+6*c+6);
+    }
+  }
+  _nbRing = _firstRing[1]-_firstRing[0];
+}
+
+TerrainClipmap::~TerrainClipmap() {
+  delete _grid;
+}
+
+void TerrainClipmap::createVAO() {
+  glGenBuffers(2,_buffers);
+  glGenVertexArrays(1,&_vao);
+
+  glBindVertexArray(_vao);
+  _grid->upload(_buffers[0],_buffers[1]); // vertices
+
+  // full grid and rings, in 16 bits when the grid has them (single patch:
+  // no base vertex)
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_buffers[1]);
+  if(_grid->shortIndices()) {
+    const vector<unsigned short> indices(_indices.begin(),_indices.end());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,indices.size()*sizeof(unsigned short),&indices[0],GL_STATIC_DRAW);
+  } else {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,_indices.size()*sizeof(int),&_indices[0],GL_STATIC_DRAW);
+  }
+  glBindVertexArray(0);
+}
+
+void TerrainClipmap::deleteVAO() {
+  glDeleteBuffers(2,_buffers);
+  glDeleteVertexArrays(1,&_vao);
+}
+
+void TerrainClipmap::update(float y) {
+  const double half = (double)_cells*0.5;
+
+  for(unsigned int l=0;l<_levels.size();++l) {
+    Level &lv = _levels[l];
+    const double s = (double)lv.spacing;
+
+    // snapping to 2s keeps the noise samples on multiples of s and
+    // the finer level on our own vertices
+    const double shift = pmod(y,2.0*s);
+    lv.x = (float)(-half*s);
+    lv.y = (float)((double)_center-half*s-shift);
+
+    if(l>0) {
+      // the finer level moved by 0 or 1 of our cells
+      lv.hole = (int)floor((shift-pmod(y,s))/s+0.5);
+    }
+  }
+}
+
+void TerrainClipmap::draw(const Shader *shader) {
+  const GLint tileLoc = shader->uniform("tile");
+
+  glUniform1f(shader->uniform("clipmap"),(float)_cells);
+  _grid->setUniform(shader);
+
+  glBindVertexArray(_vao);
+  for(unsigned int l=0;l<_levels.size();++l) {
+    const Level &lv = _levels[l];
+    glUniform3f(tileLoc,lv.x,lv.y,lv.spacing);
+
+    if(l==0) {
+      glDrawElements(GL_TRIANGLES,_nbFull,_grid->indexType(),(void *)0);
+    } else {
+      const size_t offset = _firstRing[lv.hole]*_grid->indexSize();
+      glDrawElements(GL_TRIANGLES,_nbRing,_grid->indexType(),(void *)offset);
+    }
+  }
+  glBindVertexArray(0);
+}
@@ -0,0 +1,60 @@
+#ifndef TERRAIN_CLIPMAP_H
+#define TERRAIN_CLIPMAP_H
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "grid.h"
+#include "shader.h"
+
+// Geometry clipmap terrain: nested square rings of the same small Grid
+// (integer coordinates 0..N), each ring twice as coarse as the previous
+// one. The terrain scrolls through the rings with _y: every level is
+// snapped to twice its own spacing, so its vertices always sample the
+// noise at the same places (no swimming) and the hole of a ring always
+// falls on the vertices of that ring (two hole positions are possible).
+class TerrainClipmap {
+ public:
+  TerrainClipmap(unsigned int cells=64,unsigned int nbLevels=8,
+		 float spacing=1.0f/256.0f,float ycenter=-1.0f);
+  ~TerrainClipmap();
+
+  // GPU objects (need a current OpenGL context)
+  void createVAO();
+  void deleteVAO();
+
+  // place the levels for the scrolling offset y
+  void update(float y);
+
+  // draw all the levels with the given program
+  void draw(const Shader *shader);
+
+  inline unsigned int nbLevels() const {return (unsigned int)_levels.size();}
+
+ private:
+  struct Level {
+    float x;       // lower left corner (terrain space)
+    float y;
+    float spacing; // size of a cell
+    int   hole;    // 0 or 1: row offset of the hole left for the finer level
+  };
+
+  Grid *_grid;
+
+  unsigned int _cells;
+  float        _center;
+
+  std::vector<Level> _levels;
+
+  // index ranges: full grid (finest level), then the rings with
+  // their hole at row N/4 and N/4+1
+  unsigned int _firstRing[2];
+  unsigned int _nbFull;
+  unsigned int _nbRing;
+  std::vector<int> _indices;
+
+  GLuint _vao;
+  GLuint _buffers[2];
+};
+
+#endif // TERRAIN_CLIPMAP_H
@@ -0,0 +1,69 @@
+#include "terrainCulling.h"
+#include "terrainFunction.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// max slope of riverFlow: 0.5*3*0.2 + 0.2*8*0.2 + 2*0.2*0.2
+static const float RIVER_SLOPE = 0.7f;
+
+TerrainCulling::TerrainCulling(const Grid *grid)
+  : _grid(grid) {
+
+  TerrainFunction::heightBounds(_zmin,_zmax);
+
+  // water.vert: base in {-0.5,-0.06}, 2 noises of amplitude 0.05*(1+0.005)
+  // scaled by 0.1, waves of amplitude 0.03
+  const float water = 2.0f*0.05f*1.005f*0.1f+0.03f;
+  _zmin = min(_zmin,-0.5f-water);
+  _zmax = max(_zmax,-0.06f+water);
+}
+
+void TerrainCulling::bounds(float x0,float x1,float y0,float y1,float y,
+			    glm::vec3 &bmin,glm::vec3 &bmax) const {
+  // the river moves the vertices along x by riverFlow(y+p.y)
+  const float half  = (y1-y0)*0.5f;
+  const float river = TerrainFunction::riverFlow(y+y0+half);
+  const float delta = RIVER_SLOPE*half;
+
+  bmin = glm::vec3(x0+river-delta,y0,_zmin);
+  bmax = glm::vec3(x1+river+delta,y1,_zmax);
+}
+
+void TerrainCulling::update(const glm::mat4 &viewProj,float y) {
+  const Frustum frustum(viewProj);
+  glm::vec3 bmin,bmax;
+
+  _counts.clear();
+  _offsets.clear();
+  _bases.clear();
+  for(unsigned int i=0;i<_grid->nbPatches();++i) {
+    const GridPatch &p = _grid->patch(i);
+    bounds(p.xmin,p.xmax,p.ymin,p.ymax,y,bmin,bmax);
+
+    if(!frustum.intersects(bmin,bmax))
+      continue;
+
+    // merge with the previous patch when contiguous in the index buffer
+    // and relative to the same vertex
+    const size_t size   = _grid->indexSize();
+    const size_t offset = (size_t)p.firstIndex*size;
+    if(!_counts.empty() && _bases.back()==(GLint)p.baseVertex &&
+       (size_t)_offsets.back()+_counts.back()*size==offset) {
+      _counts.back() += p.nbIndices;
+      continue;
+    }
+
+    _counts.push_back(p.nbIndices);
+    _offsets.push_back((const GLvoid *)offset);
+    _bases.push_back((GLint)p.baseVertex);
+  }
+}
+
+void TerrainCulling::draw() const {
+  if(_counts.empty())
+    return;
+
+  _grid->draw(&_counts[0],&_offsets[0],&_bases[0],(GLsizei)_counts.size());
+}
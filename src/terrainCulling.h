@@ -0,0 +1,46 @@
+#ifndef TERRAIN_CULLING_H
+#define TERRAIN_CULLING_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// OpenGL Mathematics
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "grid.h"
+
+// View frustum culling of the patches of a Grid. The bounding box of a
+// patch follows the river offset applied by the vertex shaders and the
+// height bounds of both the terrain and the water, so the same visible
+// set is used for the two passes. The survivors are drawn with a single
+// glMultiDrawElementsBaseVertex (16-bit indices are relative to the first
+// vertex of their patch, see Grid::draw).
+class TerrainCulling {
+ public:
+  TerrainCulling(const Grid *grid);
+
+  // bounding box of the terrain above [x0,x1]x[y0,y1] (terrain space)
+  // once scrolled by y
+  void bounds(float x0,float x1,float y0,float y1,float y,
+	      glm::vec3 &bmin,glm::vec3 &bmax) const;
+
+  // select the patches visible through projMat*mdvMat for offset y
+  void update(const glm::mat4 &viewProj,float y);
+
+  // draw the visible patches (the grid VAO must be bound)
+  void draw() const;
+
+  inline unsigned int nbVisible() const {return (unsigned int)_counts.size();}
+
+ private:
+  const Grid *_grid;
+  float       _zmin;
+  float       _zmax;
+
+  std::vector<GLsizei>        _counts;
+  std::vector<const GLvoid *> _offsets;
+  std::vector<GLint>          _bases;
+};
+
+#endif // TERRAIN_CULLING_H
@@ -0,0 +1,196 @@
+#include "terrainFunction.h"
+#include "simd.h"
+
+#include <math.h>
+
+using namespace simd;
+
+namespace {
+
+// GLSL helpers
+template<class V> inline V fract(V a) {return a-vfloor(a);}
+template<class V> inline V mix(V a,V b,V t) {return a*(V(1.0f)-t)+b*t;}
+template<class V> inline V clamp01(V a) {return vmin(vmax(a,V(0.0f)),V(1.0f));}
+template<class V> inline V smoothstep(float e0,float e1,V x) {
+  const V t = clamp01((x-V(e0))/V(e1-e0));
+  return t*t*(V(3.0f)-V(2.0f)*t);
+}
+
+// sine with the cephes reduction and polynomials. Only float operations
+// and selects: every width computes exactly the same values
+template<class V> V vsin(V x) {
+  const V ax = vabs(x);
+
+  // octant, rounded up to an even number
+  V j = vfloor(ax*V(1.27323954473516f));
+  j = j+(j-V(2.0f)*vfloor(j*V(0.5f)));
+
+  // extended precision modular arithmetic
+  const V r = ((ax-j*V(0.78515625f))-j*V(2.4187564849853515625e-4f))-j*V(3.77489497744594108e-8f);
+  const V z = r*r;
+
+  const V ys = ((V(-1.9515295891e-4f)*z+V(8.3321608736e-3f))*z-V(1.6666654611e-1f))*z*r+r;
+  const V yc = ((V(2.443315711809948e-5f)*z-V(1.388731625493765e-3f))*z+V(4.166664568298827e-2f))*z*z-V(0.5f)*z+V(1.0f);
+
+  // j mod 8 is 0, 2, 4 or 6: cosine for 2 and 6, negated for 4 and 6
+  const V q  = j-V(8.0f)*vfloor(j*V(0.125f));
+  const V q4 = q-V(4.0f)*vfloor(q*V(0.25f));
+  V y = vselectLess(V(1.0f),q4,yc,ys);
+  y = vselectLess(V(3.0f),q,V(0.0f)-y,y);
+
+  // odd function
+  return vselectLess(x,V(0.0f),V(0.0f)-y,y);
+}
+
+// hash of shaders/noise.glsl, one component at a time
+template<class V> inline V hashComp(V px,V py,float a,float b) {
+  return V(-1.0f)+V(2.0f)*fract(vsin(px*V(a)+py*V(b))*V(43758.5453123f));
+}
+
+template<class V> V gnoise(V px,V py) {
+  const V ix = vfloor(px);
+  const V iy = vfloor(py);
+  const V fx = px-ix;
+  const V fy = py-iy;
+
+  const V ux = fx*fx*(V(3.0f)-V(2.0f)*fx);
+  const V uy = fy*fy*(V(3.0f)-V(2.0f)*fy);
+
+  const V ix1 = ix+V(1.0f);
+  const V iy1 = iy+V(1.0f);
+  const V fx1 = fx-V(1.0f);
+  const V fy1 = fy-V(1.0f);
+
+  const V d00 = hashComp(ix ,iy ,127.1f,311.7f)*fx +hashComp(ix ,iy ,269.5f,183.3f)*fy;
+  const V d10 = hashComp(ix1,iy ,127.1f,311.7f)*fx1+hashComp(ix1,iy ,269.5f,183.3f)*fy;
+  const V d01 = hashComp(ix ,iy1,127.1f,311.7f)*fx +hashComp(ix ,iy1,269.5f,183.3f)*fy1;
+  const V d11 = hashComp(ix1,iy1,127.1f,311.7f)*fx1+hashComp(ix1,iy1,269.5f,183.3f)*fy1;
+
+  return mix(mix(d00,d10,ux),mix(d01,d11,ux),uy);
+}
+
+template<class V> V pnoise(V px,V py,float amplitude,float frequency,float persistence,int nboctaves) {
+  float a = amplitude;
+  float f = frequency;
+  V n(0.0f);
+
+  for(int i=0;i<nboctaves;++i) {
+    n = n+V(a)*gnoise(px*V(f),py*V(f));
+    f = f*2.0f;
+    a = a*persistence;
+  }
+
+  return n;
+}
+
+// computeHeight of shaders/terrainHeight.glsl at world position (x,y)
+template<class V> V height(V x,V y) {
+  // left bank
+  const V micro = pnoise(x,y,0.004f,50.0f,0.005f,2);
+  const V h1 = pnoise(x,y,0.25f,1.1f,0.05f,2)+V(0.04f)+micro;
+  // right bank
+  const V h3 = pnoise(x,y,0.1f,3.0f,0.05f,2)+micro;
+
+  // river bed
+  const float offset = -(3.1415f)/2.0f;
+  const float periode = 10.0f;
+  const V river = vmax(V(-0.12f),vmin(V(0.0f),V(0.2f)*vsin(V(offset)+x*V(periode))));
+
+  // smoothstep between tiers
+  const float v = 0.1f;
+  const float off = 0.23f;
+  const float fl = -1.0f/3.0f+off;
+  const float fr =  1.0f/3.0f-off;
+  const V left  = mix(h1,river,smoothstep(fl-v,fl+v,x));
+  const V right = mix(river,h3,smoothstep(fr-v,fr+v,x));
+
+  return vselectLess(x,V(0.0f),left,vselectLess(V(0.0f),x,right,river));
+}
+
+// computeNormal of shaders/terrainHeight.glsl
+template<class V> void normal(V x,V y,V &nx,V &ny,V &nz) {
+  const float EPS = 0.01f;
+
+  const V gx = (height(x+V(EPS),y)-height(x-V(EPS),y))/V(2.0f*EPS);
+  const V gy = (height(x,y+V(EPS))-height(x,y-V(EPS)))/V(2.0f*EPS);
+
+  // normalize(cross((1,0,gx),(0,1,-gy)))
+  const V l = vsqrt(gx*gx+gy*gy+V(1.0f));
+  nx = (V(0.0f)-gx)/l;
+  ny = gy/l;
+  nz = V(1.0f)/l;
+}
+
+template<class V> void heightsT(const float *x,const float *y,float *h,unsigned int nb) {
+  for(unsigned int i=0;i<nb;i+=V::width) {
+    height(V::load(x+i),V::load(y+i)).store(h+i);
+  }
+}
+
+template<class V> void normalsT(const float *x,const float *y,float *n,unsigned int nb) {
+  float tmp[3][V::width];
+  V nx,ny,nz;
+
+  for(unsigned int i=0;i<nb;i+=V::width) {
+    normal(V::load(x+i),V::load(y+i),nx,ny,nz);
+    nx.store(tmp[0]);
+    ny.store(tmp[1]);
+    nz.store(tmp[2]);
+    for(unsigned int j=0;j<V::width;++j) {
+      n[3*(i+j)  ] = tmp[0][j];
+      n[3*(i+j)+1] = tmp[1][j];
+      n[3*(i+j)+2] = tmp[2][j];
+    }
+  }
+}
+
+} // namespace
+
+float TerrainFunction::height(float x,float y) {
+  return ::height(F1(x),F1(y)).v;
+}
+
+void TerrainFunction::normal(float x,float y,float n[3]) {
+  F1 nx,ny,nz;
+  ::normal(F1(x),F1(y),nx,ny,nz);
+  n[0] = nx.v;
+  n[1] = ny.v;
+  n[2] = nz.v;
+}
+
+void TerrainFunction::heights(const float *x,const float *y,float *h,unsigned int nb) {
+  const unsigned int nbSimd = nb-nb%FN::width;
+  heightsT<FN>(x,y,h,nbSimd);
+  heightsT<F1>(x+nbSimd,y+nbSimd,h+nbSimd,nb-nbSimd);
+}
+
+void TerrainFunction::normals(const float *x,const float *y,float *n,unsigned int nb) {
+  const unsigned int nbSimd = nb-nb%FN::width;
+  normalsT<FN>(x,y,n,nbSimd);
+  normalsT<F1>(x+nbSimd,y+nbSimd,n+3*nbSimd,nb-nbSimd);
+}
+
+float TerrainFunction::riverFlow(float y) {
+  const float l = 0.2f;
+  return 0.5f*sinf(y*3.0f*l)+0.2f*sinf(y*8.0f*l)+2.0f*sinf(y*0.2f*l);
+}
+
+void TerrainFunction::heightBounds(float &hmin,float &hmax) {
+  // |gnoise| <= 1, so a pnoise is bounded by the sum of its amplitudes,
+  // itself below the geometric series: valid for any NOISE_OCTAVES (key O)
+  const float micro = 0.004f/(1.0f-0.005f);
+  const float left  = 0.25f/(1.0f-0.05f);
+  const float right = 0.1f/(1.0f-0.05f);
+
+  // mixes of the left bank, the river bed [-0.12,0] and the right bank
+  hmin = fminf(fminf(-left+0.04f-micro,-right-micro),-0.12f);
+  hmax = fmaxf(left+0.04f+micro,right+micro);
+}
+
+const char *TerrainFunction::simdName() {
+  switch(FN::width) {
+  case 8:  return "AVX2";
+  case 4:  return "SSE2";
+  default: return "scalar";
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef TERRAIN_FUNCTION_H
+#define TERRAIN_FUNCTION_H
+
+// CPU version of the height function of the terrain shaders (hash,
+// gnoise and pnoise of shaders/noise.glsl with the default 2 octaves,
+// computeHeight and computeNormal of shaders/terrainHeight.glsl and
+// riverFlow of shaders/river.glsl). Points are given in world space: y
+// already contains the scrolling offset _y (the shaders evaluate the
+// terrain at (p.x,p.y+_y)).
+//
+// The batch functions process the points 8 (AVX2) or 4 (SSE2) at a time,
+// depending on the instruction set the file is compiled for, and fall
+// back to scalar code otherwise. All the paths run the same operations
+// in the same order, so they give identical results. The match with the
+// GPU holds within a tolerance only: the hash amplifies the differences
+// of sin() implementations, more so for large coordinates.
+class TerrainFunction {
+ public:
+  // single point
+  static float height(float x,float y);
+  static void  normal(float x,float y,float n[3]);
+
+  // arrays of nb points, normals are stored as 3 floats per point
+  static void heights(const float *x,const float *y,float *h,unsigned int nb);
+  static void normals(const float *x,const float *y,float *n,unsigned int nb);
+
+  // lateral offset of the river at y (the same in all the shaders)
+  static float riverFlow(float y);
+
+  // conservative bounds of the terrain heights, whatever the number of
+  // octaves the shaders are built with
+  static void heightBounds(float &hmin,float &hmax);
+
+  // instruction set used by the batch functions
+  static const char *simdName();
+};
+
+#endif // TERRAIN_FUNCTION_H
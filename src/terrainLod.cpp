@@ -0,0 +1,131 @@
+#include "terrainLod.h"
+
+#include <math.h>
+
+using namespace std;
+
+TerrainLod::TerrainLod(unsigned int resol,float leafSize,unsigned int nbLevels,
+		       float xmin,float xmax,float ystart,float yend,
+		       float distanceRatio)
+  : _cells(resol-1),
+    _rootSize(leafSize*(float)(1<<(nbLevels-1))),
+    _xmin(xmin),
+    _ystart(ystart),
+    _zmin(-0.55f),
+    _zmax(0.35f),
+    _vao(0) {
+
+  // last vertex exactly on 1 (see TerrainChunks)
+  _grid = new Grid(resol,0.0f,(float)resol/(float)(resol-1),0,Grid::STRIPS);
+
+  _nbRootsX = (unsigned int)ceil((xmax-xmin)/_rootSize);
+  _nbRootsY = (unsigned int)ceil((yend-ystart)/_rootSize);
+
+  // each level is visible twice as far as the previous one. Morphing
+  // happens on the last third of the range of a level
+  const float morphStartRatio = 0.66f;
+  float prev = 0.0f;
+  float range = leafSize*distanceRatio;
+  for(unsigned int i=0;i<nbLevels;++i) {
+    _ranges.push_back(range);
+    _morphStarts.push_back(prev+(range-prev)*morphStartRatio);
+    prev   = range;
+    range *= 2.0f;
+  }
+}
+
+TerrainLod::~TerrainLod() {
+  delete _grid;
+}
+
+void TerrainLod::createVAO() {
+  glGenBuffers(2,_buffers);
+  glGenVertexArrays(1,&_vao);
+
+  // one shared grid for all the patches
+  glBindVertexArray(_vao);
+  _grid->upload(_buffers[0],_buffers[1]); // vertices, indices
+  glBindVertexArray(0);
+}
+
+void TerrainLod::deleteVAO() {
+  glDeleteBuffers(2,_buffers);
+  glDeleteVertexArrays(1,&_vao);
+}
+
+bool TerrainLod::intersects(float x,float y,float size,const glm::vec3 &cam,float range) const {
+  // distance between the camera and the bounding box of the node
+  const float dx = max(max(x-cam.x,0.0f),cam.x-(x+size));
+  const float dy = max(max(y-cam.y,0.0f),cam.y-(y+size));
+  const float dz = max(max(_zmin-cam.z,0.0f),cam.z-_zmax);
+
+  return dx*dx+dy*dy+dz*dz<=range*range;
+}
+
+void TerrainLod::add(float x,float y,float size,int level) {
+  Patch p;
+  p.x     = x;
+  p.y     = y;
+  p.size  = size;
+  p.level = level;
+  _selection.push_back(p);
+}
+
+bool TerrainLod::select(float x,float y,float size,int level,const glm::vec3 &cam) {
+  if(!intersects(x,y,size,cam,_ranges[level])) {
+    // too far for this level: the parent takes care of it
+    return false;
+  }
+
+  if(level==0) {
+    add(x,y,size,0);
+    return true;
+  }
+
+  if(!intersects(x,y,size,cam,_ranges[level-1])) {
+    // no child is close enough to be refined
+    add(x,y,size,level);
+    return true;
+  }
+
+  // refine: children out of their range are drawn fully morphed, which
+  // gives them the density of the current level
+  const float h = size*0.5f;
+  for(int i=0;i<4;++i) {
+    const float cx = x+h*(float)(i&1);
+    const float cy = y+h*(float)(i>>1);
+    if(!select(cx,cy,h,level-1,cam))
+      add(cx,cy,h,level-1);
+  }
+
+  return true;
+}
+
+void TerrainLod::update(const glm::vec3 &cam) {
+  const int top = (int)_ranges.size()-1;
+
+  _selection.clear();
+  for(unsigned int i=0;i<_nbRootsY;++i) {
+    for(unsigned int j=0;j<_nbRootsX;++j) {
+      const float x = _xmin+_rootSize*(float)j;
+      const float y = _ystart+_rootSize*(float)i;
+      if(!select(x,y,_rootSize,top,cam))
+	add(x,y,_rootSize,top);
+    }
+  }
+}
+
+void TerrainLod::draw(const Shader *shader) {
+  const GLint tileLoc  = shader->uniform("tile");
+  const GLint morphLoc = shader->uniform("morph");
+
+  _grid->setUniform(shader);
+  glBindVertexArray(_vao);
+  for(unsigned int i=0;i<_selection.size();++i) {
+    const Patch &p = _selection[i];
+    glUniform3f(tileLoc,p.x,p.y,p.size);
+    glUniform4f(morphLoc,_morphStarts[p.level],_ranges[p.level],(float)_cells,0.0f);
+    _grid->draw();
+  }
+  glBindVertexArray(0);
+}
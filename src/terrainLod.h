@@ -0,0 +1,69 @@
+#ifndef TERRAIN_LOD_H
+#define TERRAIN_LOD_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// OpenGL Mathematics
+#include <glm/glm.hpp>
+
+#include "grid.h"
+#include "shader.h"
+
+// Continuous distance-based LOD terrain (CDLOD). The terrain is covered by
+// a quadtree whose nodes are all drawn with the same small Grid: near the
+// camera small (fine) nodes are selected, far from it large (coarse) ones.
+// The vertex shaders morph the odd vertices of a patch onto the grid of the
+// next level ("morph" uniform) so that neighbouring levels match.
+class TerrainLod {
+ public:
+  TerrainLod(unsigned int resol=33,float leafSize=0.125f,unsigned int nbLevels=6,
+	     float xmin=-2.0f,float xmax=2.0f,float ystart=-1.0f,float yend=7.0f,
+	     float distanceRatio=2.0f);
+  ~TerrainLod();
+
+  // GPU objects (need a current OpenGL context)
+  void createVAO();
+  void deleteVAO();
+
+  // select the patches to draw for a camera given in terrain space
+  void update(const glm::vec3 &cam);
+
+  // draw the selected patches with the given program
+  void draw(const Shader *shader);
+
+  inline unsigned int nbPatches() const {return (unsigned int)_selection.size();}
+  inline unsigned int nbLevels () const {return (unsigned int)_ranges.size();}
+
+ private:
+  struct Patch {
+    float x;     // lower left corner
+    float y;
+    float size;  // side length
+    int   level; // 0 is the finest
+  };
+
+  bool select(float x,float y,float size,int level,const glm::vec3 &cam);
+  void add(float x,float y,float size,int level);
+  bool intersects(float x,float y,float size,const glm::vec3 &cam,float range) const;
+
+  Grid *_grid;
+
+  unsigned int _cells;     // number of cells per side of a patch
+  float        _rootSize;
+  float        _xmin;
+  float        _ystart;
+  unsigned int _nbRootsX;
+  unsigned int _nbRootsY;
+  float        _zmin;      // height bounds used for the distance tests
+  float        _zmax;
+
+  std::vector<float> _ranges;      // selection distance of each level
+  std::vector<float> _morphStarts; // distance where morphing starts
+  std::vector<Patch> _selection;
+
+  GLuint _vao;
+  GLuint _buffers[2];
+};
+
+#endif // TERRAIN_LOD_H
@@ -0,0 +1,60 @@
+#include "terrainTess.h"
+
+using namespace std;
+
+TerrainTess::TerrainTess(unsigned int resol,float minval,float maxval,float tessError)
+  : _shader(NULL),
+    _tessError(tessError),
+    _vao(0) {
+
+  _grid = new Grid(resol,minval,maxval,0,Grid::BANDS);
+}
+
+TerrainTess::~TerrainTess() {
+  delete _grid;
+  delete _shader;
+}
+
+bool TerrainTess::supported() {
+  return GLEW_VERSION_4_0 || GLEW_ARB_tessellation_shader;
+}
+
+void TerrainTess::createVAO() {
+  glGenBuffers(2,_buffers);
+  glGenVertexArrays(1,&_vao);
+
+  glBindVertexArray(_vao);
+  _grid->upload(_buffers[0],_buffers[1]); // vertices, indices
+  glBindVertexArray(0);
+}
+
+void TerrainTess::deleteVAO() {
+  glDeleteBuffers(2,_buffers);
+  glDeleteVertexArrays(1,&_vao);
+}
+
+void TerrainTess::createShader() {
+  if(!supported())
+    return;
+
+  _shader = new Shader();
+  _shader->load("shaders/terrain_tess.vert","shaders/terrain.frag",
+		"shaders/terrain.tesc","shaders/terrain.tese");
+}
+
+void TerrainTess::deleteShader() {
+  delete _shader;
+  _shader = NULL;
+}
+
+void TerrainTess::draw(int width,int height) {
+  glUniform3f(_shader->uniform("tile"),0.0f,0.0f,1.0f);
+  _grid->setUniform(_shader);
+  glUniform2f(_shader->uniform("viewport"),(float)width,(float)height);
+  glUniform1f(_shader->uniform("tessError"),_tessError);
+
+  glBindVertexArray(_vao);
+  glPatchParameteri(GL_PATCH_VERTICES,3);
+  _grid->draw(true);
+  glBindVertexArray(0);
+}
@@ -0,0 +1,43 @@
+#ifndef TERRAIN_TESS_H
+#define TERRAIN_TESS_H
+
+#include <GL/glew.h>
+
+#include "grid.h"
+#include "shader.h"
+
+// Terrain drawn with the tessellation stages (OpenGL 4.0): a coarse Grid
+// gives the patches (one per triangle), terrain.tesc subdivides each edge
+// so that it covers about tessError pixels on screen and terrain.tese
+// computes the heights of the generated vertices.
+class TerrainTess {
+ public:
+  TerrainTess(unsigned int resol=33,float minval=-1.0f,float maxval=1.0f,float tessError=8.0f);
+  ~TerrainTess();
+
+  // true if the context can run tessellation shaders
+  static bool supported();
+
+  // GPU objects (need a current OpenGL context)
+  void createVAO();
+  void deleteVAO();
+  void createShader();
+  void deleteShader();
+
+  // draw the patches with the program (shader()->id()) already in use
+  void draw(int width,int height);
+
+  inline Shader *shader   () const {return _shader;}
+  inline float   tessError() const {return _tessError;}
+  inline void    setTessError(float e) {_tessError = e<1.0f ? 1.0f : e;}
+
+ private:
+  Grid   *_grid;
+  Shader *_shader;
+  float   _tessError;
+
+  GLuint _vao;
+  GLuint _buffers[2];
+};
+
+#endif // TERRAIN_TESS_H
@@ -0,0 +1,237 @@
+#include "texture.h"
+#include "textureCompressor.h"
+#include "fileUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <QImage>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = "SIMTEX";
+
+string cachePath(const char *file) {
+  return string(file)+".bc1";
+}
+
+bool loadBlocks(const char *file,const struct stat &source,Texture::Image &image) {
+  const string path = cachePath(file);
+  const int fd = open(path.c_str(),O_RDONLY);
+  if(fd<0)
+    return false;
+
+  Texture::Header h;
+  struct stat st;
+  bool valid =
+    fstat(fd,&st)==0 && readAll(fd,&h,sizeof(h)) &&
+    memcmp(h.magic,MAGIC,sizeof(MAGIC))==0 && h.version==Texture::VERSION && h.format==image.format &&
+    h.sourceSize==(uint64_t)source.st_size &&
+    h.sourceMtime==(int64_t)source.st_mtim.tv_sec*1000000000+source.st_mtim.tv_nsec &&
+    h.nbLevels==TextureCompressor::nbLevels(h.width,h.height) &&
+    sizeof(h)+h.size==(uint64_t)st.st_size;
+
+  if(valid) {
+    uint64_t size = 0;
+    for(uint32_t l=0;l<h.nbLevels;++l)
+      size += TextureCompressor::bc1Size(TextureCompressor::levelSize(h.width,l),
+					 TextureCompressor::levelSize(h.height,l));
+    image.data.resize((size_t)h.size);
+    valid = size==h.size && readAll(fd,&image.data[0],image.data.size());
+  }
+  close(fd);
+
+  image.width    = h.width;
+  image.height   = h.height;
+  image.nbLevels = h.nbLevels;
+  return valid;
+}
+
+bool saveBlocks(const char *file,const struct stat &source,const Texture::Image &b) {
+  Texture::Header h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,MAGIC,sizeof(MAGIC));
+  h.version     = Texture::VERSION;
+  h.format      = b.format;
+  h.sourceSize  = (uint64_t)source.st_size;
+  h.sourceMtime = (int64_t)source.st_mtim.tv_sec*1000000000+source.st_mtim.tv_nsec;
+  h.width       = b.width;
+  h.height      = b.height;
+  h.nbLevels    = b.nbLevels;
+  h.size        = b.data.size();
+
+  // two reads of the same image may run at once (reload, or two handles)
+  return writeFileAtomic(cachePath(file),[&](int fd) {
+      return writeAll(fd,&h,sizeof(h)) && writeAll(fd,&b.data[0],b.data.size());
+    });
+}
+
+// RGBA8 texels of the image, first row at the bottom (GL order). QImage
+// is reentrant: this runs on any thread
+bool readImage(const char *file,unsigned int &width,unsigned int &height,vector<unsigned char> &rgba) {
+  QImage image(file);
+  if(image.isNull())
+    return false;
+
+  image  = image.convertToFormat(QImage::Format_ARGB32);
+  width  = (unsigned int)image.width();
+  height = (unsigned int)image.height();
+  rgba.resize(4*(size_t)width*height);
+
+  for(unsigned int i=0;i<height;++i) {
+    const QRgb *src = (const QRgb *)image.constScanLine((int)(height-1-i));
+    unsigned char *dst = &rgba[4*(size_t)i*width];
+    for(unsigned int j=0;j<width;++j) {
+      dst[4*j  ] = (unsigned char)qRed  (src[j]);
+      dst[4*j+1] = (unsigned char)qGreen(src[j]);
+      dst[4*j+2] = (unsigned char)qBlue (src[j]);
+      dst[4*j+3] = (unsigned char)qAlpha(src[j]);
+    }
+  }
+  return true;
+}
+
+// mip chain encoded level by level
+void encodeBlocks(const vector<unsigned char> &rgba,bool srgb,Texture::Image &b) {
+  size_t size = 0;
+  for(uint32_t l=0;l<b.nbLevels;++l)
+    size += TextureCompressor::bc1Size(TextureCompressor::levelSize(b.width,l),
+				       TextureCompressor::levelSize(b.height,l));
+  b.data.resize(size);
+
+  vector<unsigned char> level(rgba),next;
+  unsigned char *blocks = &b.data[0];
+  for(uint32_t l=0;l<b.nbLevels;++l) {
+    const unsigned int w = TextureCompressor::levelSize(b.width,l);
+    const unsigned int h = TextureCompressor::levelSize(b.height,l);
+    TextureCompressor::encodeBC1(&level[0],w,h,blocks);
+    blocks += TextureCompressor::bc1Size(w,h);
+
+    if(l+1<b.nbLevels) {
+      next.resize(4*(size_t)TextureCompressor::levelSize(w,1)*TextureCompressor::levelSize(h,1));
+      TextureCompressor::downsample(&level[0],w,h,srgb,&next[0]);
+      level.swap(next);
+    }
+  }
+}
+
+} // namespace
+
+GLenum Texture::format(unsigned int flags) {
+  const bool srgb = (flags&SRGB)!=0;
+  if((flags&COMPRESSED)!=0 && GLEW_EXT_texture_compression_s3tc && (!srgb || GLEW_EXT_texture_sRGB))
+    return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+  return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+}
+
+bool Texture::compressed(GLenum format) {
+  return format==GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format==GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+}
+
+bool Texture::read(const char *file,GLenum format,Image &image,string &error) {
+  const bool srgb = format==GL_SRGB8_ALPHA8 || format==GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+
+  image.format = format;
+  image.cached = false;
+
+  struct stat source;
+  if(stat(file,&source)!=0) {
+    error = string("Unable to open ")+file;
+    return false;
+  }
+
+  if(compressed(format) && loadBlocks(file,source,image)) {
+    image.cached = true;
+    return true;
+  }
+
+  // blocks of all the levels, or the texels of the first one
+  vector<unsigned char> rgba;
+  if(!readImage(file,image.width,image.height,rgba)) {
+    error = string("Unable to read ")+file;
+    return false;
+  }
+  image.nbLevels = TextureCompressor::nbLevels(image.width,image.height);
+
+  if(!compressed(format)) {
+    image.data.swap(rgba);
+    return true;
+  }
+
+  encodeBlocks(rgba,srgb,image);
+  if(!saveBlocks(file,source,image))
+    error = "Unable to write "+cachePath(file); // still usable
+  return true;
+}
+
+GLuint Texture::create(const Image &image,GLenum wrap,const unsigned char *pixels) {
+  const bool storage = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+
+  GLuint id;
+  glGenTextures(1,&id);
+  glBindTexture(GL_TEXTURE_2D,id);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,wrap);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,wrap);
+
+  // immutable: the driver allocates the whole chain once
+  if(storage)
+    glTexStorage2D(GL_TEXTURE_2D,image.nbLevels,image.format,image.width,image.height);
+  else
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,image.nbLevels-1);
+
+  if(compressed(image.format)) {
+    for(unsigned int l=0;l<image.nbLevels;++l) {
+      const unsigned int w = TextureCompressor::levelSize(image.width,l);
+      const unsigned int h = TextureCompressor::levelSize(image.height,l);
+      const GLsizei size   = (GLsizei)TextureCompressor::bc1Size(w,h);
+      if(storage)
+	glCompressedTexSubImage2D(GL_TEXTURE_2D,l,0,0,w,h,image.format,size,pixels);
+      else
+	glCompressedTexImage2D(GL_TEXTURE_2D,l,image.format,w,h,0,size,pixels);
+      pixels += size;
+    }
+  } else {
+    if(storage)
+      glTexSubImage2D(GL_TEXTURE_2D,0,0,0,image.width,image.height,GL_RGBA,GL_UNSIGNED_BYTE,pixels);
+    else
+      glTexImage2D(GL_TEXTURE_2D,0,image.format,image.width,image.height,0,GL_RGBA,GL_UNSIGNED_BYTE,pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+
+  return id;
+}
+
+string Texture::describe(const Image &image) {
+  const bool   bc1   = compressed(image.format);
+  const bool   srgb  = image.format==GL_SRGB8_ALPHA8 || image.format==GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+  const size_t bytes = bc1 ? image.data.size() : image.data.size()*4/3;
+
+  char text[128];
+  snprintf(text,sizeof(text),"%ux%u %s%s, %u KB%s",image.width,image.height,bc1 ? "BC1" : "RGBA8",
+	   srgb ? " sRGB" : "",(unsigned int)(bytes/1024),image.cached ? " (cached)" : "");
+  return text;
+}
+
+GLuint Texture::load(const char *file,unsigned int flags,GLenum wrap) {
+  Image image;
+  string error;
+  const bool ok = read(file,format(flags),image,error);
+  if(!error.empty())
+    cout << error << endl;
+  if(!ok)
+    return 0;
+
+  const GLuint id = create(image,wrap,&image.data[0]);
+  cout << file << ": " << describe(image) << endl;
+  return id;
+}
@@ -0,0 +1,69 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Color maps loaded from images (any format QImage reads) into immutable
+// storage (glTexStorage2D when available) with a full mip chain:
+// - 8 bits per channel (GL_RGBA8, or GL_SRGB8_ALPHA8 for sRGB maps,
+//   filtered in linear space), mipmaps generated by the driver
+// - or BC1 when COMPRESSED is asked and the driver has S3TC: the blocks
+//   of every level are encoded on the CPU (TextureCompressor) the first
+//   time and kept next to the image (<image>.bc1), used while the image
+//   keeps the same size and modification time.
+//
+// load does it all on the GL thread. read (no GL call, any thread) and
+// create split it for TextureLoader.
+class Texture {
+ public:
+  enum Flags {SRGB=1,COMPRESSED=2};
+
+  static const uint32_t VERSION = 1;
+
+  struct Header {
+    char     magic[8];    // "SIMTEX"
+    uint32_t version;     // VERSION
+    uint32_t format;      // GL internal format of the blocks
+    uint64_t sourceSize;
+    int64_t  sourceMtime; // nanoseconds
+    uint32_t width;
+    uint32_t height;
+    uint32_t nbLevels;
+    uint32_t pad;
+    uint64_t size;        // bytes of the blocks of all the levels
+  };
+
+  // texels of an image on the CPU side
+  struct Image {
+    GLenum       format; // internal format
+    unsigned int width;
+    unsigned int height;
+    unsigned int nbLevels;
+    bool         cached; // blocks read from the cache
+    std::vector<unsigned char> data; // blocks of all the levels (BC1) or
+				     // RGBA8 texels of the first one
+  };
+
+  // internal format of the images loaded with these flags on this driver
+  static GLenum format(unsigned int flags);
+  static bool   compressed(GLenum format);
+
+  // decode the image, or read its cached blocks, for the given format
+  static bool read(const char *file,GLenum format,Image &image,std::string &error);
+
+  // mipmapped texture object of the image, repeated along s and t with
+  // wrap. pixels: image.data, or its offset in the bound
+  // GL_PIXEL_UNPACK_BUFFER
+  static GLuint create(const Image &image,GLenum wrap,const unsigned char *pixels);
+
+  // size, format and memory of an image, for the logs
+  static std::string describe(const Image &image);
+
+  // read and create at once (0 if the image cannot be read)
+  static GLuint load(const char *file,unsigned int flags=0,GLenum wrap=GL_REPEAT);
+};
+
+#endif // TEXTURE_H
@@ -0,0 +1,286 @@
+#include "textureCompressor.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// sRGB <-> linear, on [0,1]
+float toLinear(float c) {
+  return c<=0.04045f ? c/12.92f : powf((c+0.055f)/1.055f,2.4f);
+}
+
+float toSrgb(float c) {
+  return c<=0.0031308f ? c*12.92f : 1.055f*powf(c,1.0f/2.4f)-0.055f;
+}
+
+inline unsigned char toByte(float c) {
+  return (unsigned char)lrintf(c<0.0f ? 0.0f : (c>255.0f ? 255.0f : c));
+}
+
+// 5:6:5 color of an RGB triple in [0,255], and back to 8 bits
+inline unsigned short pack565(const float *c) {
+  const unsigned int r = (unsigned int)lrintf(min(max(c[0],0.0f),255.0f)*31.0f/255.0f);
+  const unsigned int g = (unsigned int)lrintf(min(max(c[1],0.0f),255.0f)*63.0f/255.0f);
+  const unsigned int b = (unsigned int)lrintf(min(max(c[2],0.0f),255.0f)*31.0f/255.0f);
+  return (unsigned short)((r<<11)|(g<<5)|b);
+}
+
+inline void unpack565(unsigned short c,int *rgb) {
+  const int r = (c>>11)&31;
+  const int g = (c>>5)&63;
+  const int b = c&31;
+  rgb[0] = (r<<3)|(r>>2);
+  rgb[1] = (g<<2)|(g>>4);
+  rgb[2] = (b<<3)|(b>>2);
+}
+
+// the 4 colors of a block with c0>c1 (c0==c1: a single color)
+void palette(unsigned short c0,unsigned short c1,int colors[4][3]) {
+  unpack565(c0,colors[0]);
+  unpack565(c1,colors[1]);
+  for(int k=0;k<3;++k) {
+    colors[2][k] = (2*colors[0][k]+colors[1][k])/3;
+    colors[3][k] = (colors[0][k]+2*colors[1][k])/3;
+  }
+}
+
+// endpoints of the block along the principal axis of its colors
+void fitEndpoints(const float texels[16][3],float e0[3],float e1[3]) {
+  float mean[3] = {0.0f,0.0f,0.0f};
+  for(int i=0;i<16;++i)
+    for(int k=0;k<3;++k)
+      mean[k] += texels[i][k]/16.0f;
+
+  float cov[6] = {0.0f,0.0f,0.0f,0.0f,0.0f,0.0f}; // rr rg rb gg gb bb
+  for(int i=0;i<16;++i) {
+    const float r = texels[i][0]-mean[0];
+    const float g = texels[i][1]-mean[1];
+    const float b = texels[i][2]-mean[2];
+    cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+    cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+  }
+
+  // power iterations from the luminance direction
+  float axis[3] = {1.0f,1.0f,1.0f};
+  for(int it=0;it<8;++it) {
+    const float x = cov[0]*axis[0]+cov[1]*axis[1]+cov[2]*axis[2];
+    const float y = cov[1]*axis[0]+cov[3]*axis[1]+cov[4]*axis[2];
+    const float z = cov[2]*axis[0]+cov[4]*axis[1]+cov[5]*axis[2];
+    const float l = max(fabsf(x),max(fabsf(y),fabsf(z)));
+    if(l==0.0f)
+      break;
+    axis[0] = x/l; axis[1] = y/l; axis[2] = z/l;
+  }
+
+  const float l2 = axis[0]*axis[0]+axis[1]*axis[1]+axis[2]*axis[2];
+  float tmin = 0.0f,tmax = 0.0f;
+  for(int i=0;i<16;++i) {
+    const float t = ((texels[i][0]-mean[0])*axis[0]+(texels[i][1]-mean[1])*axis[1]+
+		     (texels[i][2]-mean[2])*axis[2])/l2;
+    tmin = min(tmin,t);
+    tmax = max(tmax,t);
+  }
+
+  for(int k=0;k<3;++k) {
+    e0[k] = mean[k]+tmax*axis[k];
+    e1[k] = mean[k]+tmin*axis[k];
+  }
+}
+
+// least squares endpoints for the current choice of the palette entries
+void refineEndpoints(const float texels[16][3],const unsigned char *indices,float e0[3],float e1[3]) {
+  static const float weights[4] = {1.0f,0.0f,2.0f/3.0f,1.0f/3.0f};
+
+  float aa = 0.0f,ab = 0.0f,bb = 0.0f;
+  float ax[3] = {0.0f,0.0f,0.0f},bx[3] = {0.0f,0.0f,0.0f};
+  for(int i=0;i<16;++i) {
+    const float a = weights[indices[i]];
+    const float b = 1.0f-a;
+    aa += a*a; ab += a*b; bb += b*b;
+    for(int k=0;k<3;++k) {
+      ax[k] += a*texels[i][k];
+      bx[k] += b*texels[i][k];
+    }
+  }
+
+  const float det = aa*bb-ab*ab;
+  if(fabsf(det)<1e-6f)
+    return;
+
+  for(int k=0;k<3;++k) {
+    e0[k] = (ax[k]*bb-bx[k]*ab)/det;
+    e1[k] = (bx[k]*aa-ax[k]*ab)/det;
+  }
+}
+
+// nearest palette entry of each texel, total squared error
+int chooseIndices(const float texels[16][3],unsigned short c0,unsigned short c1,unsigned char *indices) {
+  int colors[4][3];
+  palette(c0,c1,colors);
+
+  int total = 0;
+  for(int i=0;i<16;++i) {
+    int best = 0,bestError = -1;
+    for(int j=0;j<(c0==c1 ? 1 : 4);++j) {
+      int error = 0;
+      for(int k=0;k<3;++k) {
+	const int d = (int)texels[i][k]-colors[j][k];
+	error += d*d;
+      }
+      if(bestError<0 || error<bestError) {
+	best      = j;
+	bestError = error;
+      }
+    }
+    indices[i] = (unsigned char)best;
+    total += bestError;
+  }
+  return total;
+}
+
+// quantized endpoints in the 4 colors order (c0>=c1)
+void quantize(const float e0[3],const float e1[3],unsigned short &c0,unsigned short &c1) {
+  c0 = pack565(e0);
+  c1 = pack565(e1);
+  if(c0<c1)
+    swap(c0,c1);
+}
+
+void encodeBlock(const float texels[16][3],unsigned char *block) {
+  float e0[3],e1[3];
+  fitEndpoints(texels,e0,e1);
+
+  unsigned short c0,c1;
+  unsigned char indices[16];
+  quantize(e0,e1,c0,c1);
+  int error = chooseIndices(texels,c0,c1,indices);
+
+  // one least squares pass, kept if it does better
+  if(c0!=c1) {
+    refineEndpoints(texels,indices,e0,e1);
+    unsigned short r0,r1;
+    unsigned char refined[16];
+    quantize(e0,e1,r0,r1);
+    const int e = chooseIndices(texels,r0,r1,refined);
+    if(e<error) {
+      c0 = r0;
+      c1 = r1;
+      memcpy(indices,refined,sizeof(indices));
+      error = e;
+    }
+  }
+
+  unsigned int bits = 0;
+  for(int i=0;i<16;++i)
+    bits |= (unsigned int)indices[i]<<(2*i);
+
+  // little endian
+  block[0] = (unsigned char)(c0&0xff); block[1] = (unsigned char)(c0>>8);
+  block[2] = (unsigned char)(c1&0xff); block[3] = (unsigned char)(c1>>8);
+  for(int k=0;k<4;++k)
+    block[4+k] = (unsigned char)((bits>>(8*k))&0xff);
+}
+
+} // namespace
+
+unsigned int TextureCompressor::nbLevels(unsigned int width,unsigned int height) {
+  unsigned int n = 1;
+  for(unsigned int s=max(width,height);s>1;s>>=1)
+    ++n;
+  return n;
+}
+
+void TextureCompressor::downsample(const unsigned char *rgba,unsigned int width,unsigned int height,
+				   bool srgb,unsigned char *half) {
+  const unsigned int w = levelSize(width,1);
+  const unsigned int h = levelSize(height,1);
+
+  // averages of the sRGB colors in linear space
+  float linear[256];
+  for(int c=0;c<256;++c)
+    linear[c] = srgb ? toLinear((float)c/255.0f) : (float)c/255.0f;
+
+  for(unsigned int i=0;i<h;++i) {
+    const unsigned int i0 = min(2*i,height-1),i1 = min(2*i+1,height-1);
+    for(unsigned int j=0;j<w;++j) {
+      const unsigned int j0 = min(2*j,width-1),j1 = min(2*j+1,width-1);
+      const unsigned char *t[4] = {
+	rgba+4*((size_t)i0*width+j0),rgba+4*((size_t)i0*width+j1),
+	rgba+4*((size_t)i1*width+j0),rgba+4*((size_t)i1*width+j1)
+      };
+
+      unsigned char *d = half+4*((size_t)i*w+j);
+      for(int k=0;k<3;++k) {
+	const float c = (linear[t[0][k]]+linear[t[1][k]]+linear[t[2][k]]+linear[t[3][k]])*0.25f;
+	d[k] = toByte((srgb ? toSrgb(c) : c)*255.0f);
+      }
+      d[3] = (unsigned char)((t[0][3]+t[1][3]+t[2][3]+t[3][3]+2)/4);
+    }
+  }
+}
+
+size_t TextureCompressor::bc1Size(unsigned int width,unsigned int height) {
+  return (size_t)((width+3)/4)*((height+3)/4)*8;
+}
+
+void TextureCompressor::encodeBC1(const unsigned char *rgba,unsigned int width,unsigned int height,
+				  unsigned char *blocks) {
+  const unsigned int bw = (width+3)/4;
+  const unsigned int bh = (height+3)/4;
+
+  float texels[16][3];
+  for(unsigned int bi=0;bi<bh;++bi) {
+    for(unsigned int bj=0;bj<bw;++bj) {
+      for(unsigned int y=0;y<4;++y) {
+	const unsigned int i = min(4*bi+y,height-1);
+	for(unsigned int x=0;x<4;++x) {
+	  const unsigned char *t = rgba+4*((size_t)i*width+min(4*bj+x,width-1));
+	  for(int k=0;k<3;++k)
+	    texels[4*y+x][k] = (float)t[k];
+	}
+      }
+      encodeBlock(texels,blocks+8*((size_t)bi*bw+bj));
+    }
+  }
+}
+
+void TextureCompressor::decodeBC1(const unsigned char *blocks,unsigned int width,unsigned int height,
+				  unsigned char *rgba) {
+  const unsigned int bw = (width+3)/4;
+  const unsigned int bh = (height+3)/4;
+
+  for(unsigned int bi=0;bi<bh;++bi) {
+    for(unsigned int bj=0;bj<bw;++bj) {
+      const unsigned char *b = blocks+8*((size_t)bi*bw+bj);
+      const unsigned short c0 = (unsigned short)(b[0]|(b[1]<<8));
+      const unsigned short c1 = (unsigned short)(b[2]|(b[3]<<8));
+      const unsigned int bits = (unsigned int)b[4]|((unsigned int)b[5]<<8)|
+	                        ((unsigned int)b[6]<<16)|((unsigned int)b[7]<<24);
+
+      // 3 colors mode (c0<=c1): middle entry, then black
+      int colors[4][3];
+      palette(c0,c1,colors);
+      if(c0<=c1) {
+	for(int k=0;k<3;++k) {
+	  colors[2][k] = (colors[0][k]+colors[1][k])/2;
+	  colors[3][k] = 0;
+	}
+      }
+
+      for(unsigned int y=0;y<4 && 4*bi+y<height;++y) {
+	for(unsigned int x=0;x<4 && 4*bj+x<width;++x) {
+	  const int *c = colors[(bits>>(2*(4*y+x)))&3];
+	  unsigned char *d = rgba+4*((size_t)(4*bi+y)*width+4*bj+x);
+	  d[0] = (unsigned char)c[0];
+	  d[1] = (unsigned char)c[1];
+	  d[2] = (unsigned char)c[2];
+	  d[3] = 255;
+	}
+      }
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <stddef.h>
+
+// CPU side of the compressed textures: mip chains of RGBA8 images and
+// their BC1 encoding (S3TC DXT1: each block of 4x4 texels in 8 bytes, two
+// 5:6:5 endpoints and a 2-bit index per texel on the segment between
+// them, alpha dropped). 4 bits per texel instead of 32 for RGBA8 and 128
+// for RGBA32F.
+class TextureCompressor {
+ public:
+  // levels of a full mip chain, down to 1x1
+  static unsigned int nbLevels(unsigned int width,unsigned int height);
+
+  // width or height of a level
+  static inline unsigned int levelSize(unsigned int size,unsigned int level) {
+    return size>>level>0 ? size>>level : 1;
+  }
+
+  // next level of an RGBA8 image (2x2 box filter, in linear space if srgb)
+  static void downsample(const unsigned char *rgba,unsigned int width,unsigned int height,
+			 bool srgb,unsigned char *half);
+
+  // bytes of the BC1 blocks of an image
+  static size_t bc1Size(unsigned int width,unsigned int height);
+
+  // encode an RGBA8 image, row by row of blocks (the texels beyond the
+  // borders repeat the last row and column)
+  static void encodeBC1(const unsigned char *rgba,unsigned int width,unsigned int height,
+			unsigned char *blocks);
+
+  // the inverse, into RGBA8 (alpha 255)
+  static void decodeBC1(const unsigned char *blocks,unsigned int width,unsigned int height,
+			unsigned char *rgba);
+};
+
+#endif // TEXTURE_COMPRESSOR_H
@@ -0,0 +1,219 @@
+#include "textureLoader.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// offsets in the ring stay aligned for any unpack alignment
+const size_t ALIGNMENT = 16;
+
+inline size_t alignUp(size_t n) {return (n+ALIGNMENT-1)&~(ALIGNMENT-1);}
+
+} // namespace
+
+TextureLoader::TextureLoader()
+  : _pool(NB_THREADS),
+    _pbo(0),
+    _ring(NULL),
+    _head(0) {
+
+  const unsigned char grey[4] = {128,128,128,255};
+  glGenTextures(1,&_placeholder);
+  glBindTexture(GL_TEXTURE_2D,_placeholder);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,1,1,0,GL_RGBA,GL_UNSIGNED_BYTE,grey);
+  glBindTexture(GL_TEXTURE_2D,0);
+
+  if(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT;
+    glGenBuffers(1,&_pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,_pbo);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER,RING_SIZE,NULL,flags);
+    _ring = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,0,RING_SIZE,flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+
+    if(!_ring) {
+      glDeleteBuffers(1,&_pbo);
+      _pbo = 0;
+    }
+  }
+}
+
+TextureLoader::~TextureLoader() {
+  // the tasks write in this object
+  _pool.wait();
+
+  for(size_t i=0;i<_inFlight.size();++i)
+    glDeleteSync(_inFlight[i].fence);
+
+  if(_pbo) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,_pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+    glDeleteBuffers(1,&_pbo);
+  }
+
+  for(size_t i=0;i<_entries.size();++i) {
+    if(_entries[i].id!=_placeholder)
+      glDeleteTextures(1,&_entries[i].id);
+  }
+  glDeleteTextures(1,&_placeholder);
+}
+
+TextureLoader::Handle TextureLoader::load(const char *file,unsigned int flags,GLenum wrap) {
+  Entry e;
+  e.file       = file;
+  e.format     = Texture::format(flags); // asks the driver: GL thread
+  e.wrap       = wrap;
+  e.id         = _placeholder;
+  e.generation = 0;
+  _entries.push_back(e);
+
+  const Handle handle = (Handle)(_entries.size()-1);
+  request(handle);
+  return handle;
+}
+
+void TextureLoader::reload(Handle handle) {
+  request(handle);
+}
+
+void TextureLoader::reloadAll() {
+  for(Handle h=0;h<(Handle)_entries.size();++h)
+    request(h);
+}
+
+void TextureLoader::request(Handle handle) {
+  Entry &e = _entries[handle];
+  e.generation++;
+
+  const string       file       = e.file;
+  const GLenum       format     = e.format;
+  const unsigned int generation = e.generation;
+
+  _pool.submit([this,handle,generation,file,format]() {
+      Result r;
+      r.handle     = handle;
+      r.generation = generation;
+      r.ok         = Texture::read(file.c_str(),format,r.image,r.error);
+
+      lock_guard<mutex> lock(_mutex);
+      _finished.push_back(move(r));
+    });
+}
+
+bool TextureLoader::update() {
+  retire();
+
+  {
+    lock_guard<mutex> lock(_mutex);
+    for(size_t i=0;i<_finished.size();++i)
+      _ready.push_back(move(_finished[i]));
+    _finished.clear();
+  }
+
+  bool changed = false;
+  size_t uploaded = 0;
+
+  while(!_ready.empty() && uploaded<FRAME_BUDGET) {
+    const Result &r = _ready.front();
+    Entry &e = _entries[r.handle];
+
+    if(r.generation==e.generation) {
+      if(!r.error.empty())
+	cout << r.error << endl;
+
+      if(r.ok) {
+	if(!upload(r))
+	  break; // the ring is full, next frame
+	uploaded += r.image.data.size();
+	changed = true;
+      }
+    }
+
+    _ready.pop_front();
+  }
+
+  return changed;
+}
+
+bool TextureLoader::upload(const Result &r) {
+  Entry &e = _entries[r.handle];
+  const Texture::Image &image = r.image;
+  const size_t size = image.data.size();
+  const bool streamed = _pbo && size<=RING_SIZE;
+  GLuint id;
+
+  if(streamed) {
+    size_t offset;
+    if(!reserve(size,offset))
+      return false;
+
+    // coherent mapping: visible to the driver without a flush
+    memcpy(_ring+offset,&image.data[0],size);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,_pbo);
+    id = Texture::create(image,e.wrap,(const unsigned char *)(uintptr_t)offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+
+    Region region;
+    region.begin = offset;
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    _inFlight.push_back(region);
+  } else {
+    id = Texture::create(image,e.wrap,&image.data[0]);
+  }
+
+  if(e.id!=_placeholder)
+    glDeleteTextures(1,&e.id);
+  e.id = id;
+
+  cout << e.file << ": " << Texture::describe(image) << (streamed ? " (streamed)" : "") << endl;
+  return true;
+}
+
+bool TextureLoader::reserve(size_t size,size_t &offset) {
+  if(_inFlight.empty()) {
+    // nothing read by the driver: start again at the beginning
+    offset = 0;
+    _head  = alignUp(size);
+    return true;
+  }
+
+  // [tail,head) is in use, possibly wrapped. The head never reaches the
+  // tail again, so head==tail only means an empty ring
+  const size_t tail = _inFlight.front().begin;
+
+  if(_head>tail) {
+    if(_head+size<=RING_SIZE) {
+      offset = _head;
+    } else if(size<tail) {
+      offset = 0;
+    } else {
+      return false;
+    }
+  } else if(_head+size<tail) {
+    offset = _head;
+  } else {
+    return false;
+  }
+
+  _head = alignUp(offset+size);
+  return true;
+}
+
+void TextureLoader::retire() {
+  // fences signal in order: stop at the first one still pending
+  while(!_inFlight.empty()) {
+    const GLenum status = glClientWaitSync(_inFlight.front().fence,0,0);
+    if(status!=GL_ALREADY_SIGNALED && status!=GL_CONDITION_SATISFIED)
+      break;
+
+    glDeleteSync(_inFlight.front().fence);
+    _inFlight.pop_front();
+  }
+}
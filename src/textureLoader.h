@@ -0,0 +1,102 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <GL/glew.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "texture.h"
+#include "threadPool.h"
+
+// Textures loaded in the background: the images are decoded (or their
+// cached BC1 blocks read) by a pool of its own, and update copies the
+// finished ones into a persistently mapped pixel buffer (a ring of
+// RING_SIZE bytes) from which the driver fills the texture objects
+// without stalling the frame. A fence per upload tells when its part of the ring can be
+// written again. Until its data arrives, a texture is a 1x1 grey
+// placeholder; a reloaded texture keeps its old content until then.
+// Without GL 4.4 / ARB_buffer_storage, or for an image larger than the
+// ring, the upload is done from the CPU copy.
+class TextureLoader {
+ public:
+  typedef unsigned int Handle;
+
+  static const size_t RING_SIZE    = 16<<20; // bytes of the pixel buffer
+  static const size_t FRAME_BUDGET = 4<<20;  // bytes uploaded per frame (at least one texture)
+
+  // decoding threads. Not shared: a thread waiting in parallelFor runs any
+  // queued task of its pool, the GL thread would decode images there
+  static const unsigned int NB_THREADS = 2;
+
+  // GL context current
+  TextureLoader();
+  ~TextureLoader();
+
+  // start loading an image (see Texture::load)
+  Handle load(const char *file,unsigned int flags=0,GLenum wrap=GL_REPEAT);
+
+  // read the image again, replaced when done (a pending load is dropped)
+  void reload(Handle handle);
+  void reloadAll();
+
+  // texture object to bind for the handle: the placeholder or the last
+  // uploaded image. Changes at the frames where update uploads the image
+  inline GLuint id(Handle handle) const {return _entries[handle].id;}
+
+  // once per frame: upload the images decoded since the last call, within
+  // the budget (false if nothing changed)
+  bool update();
+
+ private:
+  struct Entry {
+    std::string  file;
+    GLenum       format;
+    GLenum       wrap;
+    GLuint       id;         // placeholder until the first upload
+    unsigned int generation; // of the last request, older results are dropped
+  };
+
+  // image read by a task
+  struct Result {
+    Handle         handle;
+    unsigned int   generation;
+    bool           ok;
+    std::string    error;
+    Texture::Image image;
+  };
+
+  // part of the ring read by the driver until its fence is signaled (it
+  // ends where the next one begins)
+  struct Region {
+    size_t begin;
+    GLsync fence;
+  };
+
+  void request(Handle handle);
+
+  // false if the ring has no room for it yet
+  bool upload(const Result &r);
+
+  // offset of size free bytes in the ring, false if there are none yet
+  bool reserve(size_t size,size_t &offset);
+
+  // release the regions the driver is done with
+  void retire();
+
+  ThreadPool          _pool;
+  std::vector<Entry>  _entries;
+  GLuint              _placeholder;
+
+  std::mutex          _mutex;
+  std::vector<Result> _finished; // by the tasks, guarded by _mutex
+  std::deque<Result>  _ready;    // waiting for room in the ring (GL thread)
+
+  GLuint              _pbo;      // 0 without persistent mapping
+  unsigned char      *_ring;
+  size_t              _head;     // next free byte
+  std::deque<Region>  _inFlight; // oldest first
+};
+
+#endif // TEXTURE_LOADER_H
@@ -0,0 +1,175 @@
+#include "threadPool.h"
+
+using namespace std;
+
+// pool and index of the worker running on the current thread
+static thread_local ThreadPool  *currentPool   = NULL;
+static thread_local unsigned int currentWorker = 0;
+
+ThreadPool::ThreadPool(unsigned int nbThreads)
+  : _pending(0),
+    _queued(0),
+    _next(0),
+    _stop(false) {
+
+  if(nbThreads==0)
+    nbThreads = max(1u,thread::hardware_concurrency());
+
+  for(unsigned int i=0;i<nbThreads;++i)
+    _queues.push_back(new Queue());
+
+  for(unsigned int i=0;i<nbThreads;++i)
+    _threads.push_back(thread(&ThreadPool::work,this,i));
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+
+  {
+    lock_guard<mutex> lock(_sleepMutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+
+  for(unsigned int i=0;i<_threads.size();++i)
+    _threads[i].join();
+
+  for(unsigned int i=0;i<_queues.size();++i)
+    delete _queues[i];
+}
+
+void ThreadPool::push(const Task &t) {
+  // a worker keeps its subtasks for itself, others are spread around
+  const unsigned int i = currentPool==this ? currentWorker : _next++%_queues.size();
+
+  {
+    lock_guard<mutex> lock(_queues[i]->mutex);
+    _queues[i]->tasks.push_back(t);
+  }
+
+  {
+    // under the lock, so that a worker about to sleep cannot miss it
+    lock_guard<mutex> lock(_sleepMutex);
+    _queued++;
+  }
+  _wake.notify_one();
+}
+
+bool ThreadPool::pop(unsigned int i,Task &t) {
+  lock_guard<mutex> lock(_queues[i]->mutex);
+  if(_queues[i]->tasks.empty())
+    return false;
+
+  t = _queues[i]->tasks.back();
+  _queues[i]->tasks.pop_back();
+  _queued--;
+  return true;
+}
+
+bool ThreadPool::steal(unsigned int i,Task &t) {
+  const unsigned int n = (unsigned int)_queues.size();
+
+  for(unsigned int k=1;k<=n;++k) {
+    Queue *q = _queues[(i+k)%n];
+    lock_guard<mutex> lock(q->mutex);
+    if(q->tasks.empty())
+      continue;
+
+    t = q->tasks.front();
+    q->tasks.pop_front();
+    _queued--;
+    return true;
+  }
+
+  return false;
+}
+
+bool ThreadPool::grab(Task &t) {
+  if(currentPool==this)
+    return pop(currentWorker,t) || steal(currentWorker,t);
+
+  return steal(_next%_queues.size(),t);
+}
+
+void ThreadPool::run(Task &t) {
+  t.f();
+
+  if(--(*t.group)==0) {
+    lock_guard<mutex> lock(_sleepMutex);
+    _done.notify_all();
+  }
+}
+
+void ThreadPool::helpUntilDone(atomic<unsigned int> &group) {
+  Task t;
+
+  while(group>0) {
+    if(grab(t)) {
+      run(t);
+      continue;
+    }
+
+    // nothing left to steal: the last tasks are running elsewhere
+    unique_lock<mutex> lock(_sleepMutex);
+    _done.wait(lock,[&]{return group==0 || _queued>0;});
+  }
+}
+
+void ThreadPool::work(unsigned int i) {
+  currentPool   = this;
+  currentWorker = i;
+
+  Task t;
+  while(true) {
+    if(pop(i,t) || steal(i,t)) {
+      run(t);
+      continue;
+    }
+
+    unique_lock<mutex> lock(_sleepMutex);
+    _wake.wait(lock,[&]{return _stop || _queued>0;});
+    if(_stop && _queued==0)
+      return;
+  }
+}
+
+void ThreadPool::submit(const function<void()> &task) {
+  Task t;
+  t.f     = task;
+  t.group = &_pending;
+
+  _pending++;
+  push(t);
+}
+
+void ThreadPool::wait() {
+  helpUntilDone(_pending);
+}
+
+void ThreadPool::parallelFor(unsigned int begin,unsigned int end,unsigned int grain,
+			     const function<void(unsigned int,unsigned int)> &f) {
+  if(begin>=end)
+    return;
+
+  grain = max(1u,grain);
+  atomic<unsigned int> group((end-begin+grain-1)/grain);
+
+  for(unsigned int first=begin;first<end;first+=grain) {
+    const unsigned int last = min(end,first+grain);
+
+    Task t;
+    t.f     = [&f,first,last]() {f(first,last);};
+    t.group = &group;
+    push(t);
+  }
+
+  helpUntilDone(group);
+}
+
+void forRange(ThreadPool *pool,unsigned int n,unsigned int grain,
+	      const function<void(unsigned int,unsigned int)> &f) {
+  if(pool)
+    pool->parallelFor(0,n,grain,f);
+  else if(n>0)
+    f(0,n);
+}
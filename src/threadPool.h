@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Each worker owns a deque: it pushes and pops
+// its own tasks at the back, idle workers (and threads waiting for a
+// result) steal from the front of the other deques. Tasks submitted from
+// outside are spread round-robin over the workers.
+class ThreadPool {
+ public:
+  ThreadPool(unsigned int nbThreads=0); // 0: one per hardware thread
+  ~ThreadPool();
+
+  // run a task asynchronously
+  void submit(const std::function<void()> &task);
+
+  // wait for all the tasks given to submit (the caller helps)
+  void wait();
+
+  // call f(first,last) on sub-ranges of [begin,end) of at most grain
+  // elements and return when they are all done
+  void parallelFor(unsigned int begin,unsigned int end,unsigned int grain,
+		   const std::function<void(unsigned int,unsigned int)> &f);
+
+  inline unsigned int nbThreads() const {return (unsigned int)_threads.size();}
+
+ private:
+  struct Task {
+    std::function<void()>      f;
+    std::atomic<unsigned int> *group; // counter decremented when done
+  };
+
+  struct Queue {
+    std::mutex       mutex;
+    std::deque<Task> tasks;
+  };
+
+  void push(const Task &t);
+  bool pop(unsigned int i,Task &t);
+  bool steal(unsigned int i,Task &t);
+  bool grab(Task &t);
+  void run(Task &t);
+  void helpUntilDone(std::atomic<unsigned int> &group);
+  void work(unsigned int i);
+
+  std::vector<Queue *>     _queues;
+  std::vector<std::thread> _threads;
+
+  std::atomic<unsigned int> _pending; // tasks given to submit, not finished
+  std::atomic<unsigned int> _queued;  // tasks waiting in the deques
+  std::atomic<unsigned int> _next;    // round-robin for external submissions
+
+  std::mutex              _sleepMutex;
+  std::condition_variable _wake;      // tasks were queued
+  std::condition_variable _done;      // a group finished
+  bool                    _stop;
+};
+
+// f(first,last) on [0,n): by pool->parallelFor, or at once without pool
+void forRange(ThreadPool *pool,unsigned int n,unsigned int grain,
+	      const std::function<void(unsigned int,unsigned int)> &f);
+
+#endif // THREAD_POOL_H
@@ -1,5 +1,7 @@
 #include "viewer.h"
 #include "meshLoader.h"
+#include "terrainFunction.h"
+#include "texture.h"
 
 #include <math.h>
 #include <iostream>
@@ -23,13 +25,28 @@ Viewer::Viewer(char *,const QGLFormat &format)
     _lookAtX(0),
     _t(.0),
     _mode(false),
-    _ndResol(512) {
+    _noiseOctaves(2),
+    _ndResol(512),
+    _measure(false) {
 
   setlocale(LC_ALL,"C");
 
   _tree = new Mesh("models/cloud.off");
-
-  _grid = new Grid(_ndResol,-1.0f,1.0f);
+  if(!_tree->loaded())
+    cerr << "Warning: " << _tree->error << endl;
+  _clouds = new CloudField(_tree);
+
+  _pool = new ThreadPool();
+  _grid = new Grid(_ndResol,-1.0f,1.0f,32,Grid::STRIPS);
+  _culling = new TerrainCulling(_grid);
+  _useCulling = true;
+  _chunks = new TerrainChunks();
+  _lod = new TerrainLod();
+  _clipmap = new TerrainClipmap();
+  _heightCache = new HeightCache();
+  _tess = new TerrainTess();
+  _useHeightCache = true;
+  _terrainMode = GRID_TERRAIN;
   _cam  = new Camera(1.0f,glm::vec3(0.0f,0.0f,0.0f));
 
   _timer->setInterval(10);
@@ -41,21 +58,33 @@ void Viewer::QtTimerEvt(){
     _t += 10.;
 }
 Viewer::~Viewer() {
+  // delete all GPU objects, while the objects owning them are alive
+  deleteShaders();
+  deleteTextures();
+  deleteVAO();
+  _heightCache->destroy();
+
   delete _timer;
+  delete _culling;
   delete _grid;
+  delete _chunks;
+  delete _lod;
+  delete _clipmap;
   delete _cam;
+  delete _clouds;
   delete _tree;
-
-  // delete all GPU objects
-  deleteShaders();
-  deleteTextures();
-  deleteVAO();
+  delete _heightCache;
+  delete _tess;
+  delete _pool;
 }
 
 void Viewer::createVAO() {
-    // buffers des arbres
-    glGenVertexArrays(1, &_vaoThrees);
-    glGenBuffers(3, _buffers);
+  // per-frame uniforms, bound once for all the programs
+  glGenBuffers(1,&_frameUbo);
+  glBindBuffer(GL_UNIFORM_BUFFER,_frameUbo);
+  glBufferData(GL_UNIFORM_BUFFER,sizeof(FrameData),NULL,GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER,0);
+  glBindBufferBase(GL_UNIFORM_BUFFER,0,_frameUbo);
 
   // cree les buffers associés au terrain
 
@@ -64,45 +93,63 @@ void Viewer::createVAO() {
 
   // create the VBO associated with the grid (the terrain)
   glBindVertexArray(_vaoTerrain);
-  glBindBuffer(GL_ARRAY_BUFFER,_terrain[0]); // vertices
-  glBufferData(GL_ARRAY_BUFFER,_grid->nbVertices()*3*sizeof(float),_grid->vertices(),GL_STATIC_DRAW);
-  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void *)0);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,_terrain[1]); // indices 
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,_grid->nbFaces()*3*sizeof(int),_grid->faces(),GL_STATIC_DRAW);
+  _grid->upload(_terrain[0],_terrain[1],_pool); // vertices, indices
 
+  // vertex shader runs and triangles of the terrain passes (key p)
+  glGenQueries(2,_queries);
+
+  // shared grids of the terrain chunks, LOD patches and clipmap rings
+  _chunks->createVAO();
+  _lod->createVAO();
+  _clipmap->createVAO();
+  _tess->createVAO();
+  _clouds->createVAO();
 }
 
 void Viewer::deleteVAO() {
-    glDeleteBuffers(3, _buffers);
-    glDeleteVertexArrays(1, &_vaoThrees);
+  glDeleteBuffers(1,&_frameUbo);
   glDeleteBuffers(2,_terrain);
   glDeleteVertexArrays(1,&_vaoTerrain);
+  glDeleteQueries(2,_queries);
+  _chunks->deleteVAO();
+  _lod->deleteVAO();
+  _clipmap->deleteVAO();
+  _tess->deleteVAO();
+  _clouds->deleteVAO();
 }
 
-void Viewer::loadMeshIntoVAO() { // Into GPU
-    glBindVertexArray(_vaoThrees);
+void Viewer::setGrid(unsigned int resol,Grid::Topology topology) {
+  QTime timer;
+  timer.start();
 
-    // Store mesh positions into buffer 0
-    glBindBuffer(GL_ARRAY_BUFFER, _buffers[0]);
-    glBufferData(GL_ARRAY_BUFFER, _tree->nb_vertices*3*sizeof(float), _tree->vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void *)0);
-    glEnableVertexAttribArray(0);
+  delete _culling;
+  delete _grid;
+  _ndResol = resol;
+  _grid    = new Grid(_ndResol,-1.0f,1.0f,32,topology);
+  _culling = new TerrainCulling(_grid);
 
-    // Store mesh indices into buffer 1
-    glBindBuffer(GL_ARRAY_BUFFER, _buffers[1]);
-    glBufferData(GL_ARRAY_BUFFER, _tree->nb_vertices*3*sizeof(float), _tree->normals, GL_STATIC_DRAW);
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_TRUE,0,(void *)0);
-    glEnableVertexAttribArray(1);
+  glBindVertexArray(_vaoTerrain);
+  _grid->upload(_terrain[0],_terrain[1],_pool);
+  glBindVertexArray(0);
+
+  cout << "Grid: " << _ndResol << "x" << _ndResol << " vertices in " << timer.elapsed() << " ms" << endl;
+}
 
-    // Store mesh normals into buffer 2
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffers[2]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, _tree->nb_faces*3*sizeof(float), _tree->faces, GL_STATIC_DRAW);
+void Viewer::setNoiseOctaves(unsigned int octaves) {
+  Shader *shaders[4] = {_terrainShader,_waterShader,_heightCache->shader(),_tess->shader()};
 
-    glBindVertexArray(0);
+  _noiseOctaves = octaves;
+  for(unsigned int i=0;i<4;++i) {
+    if(shaders[i])
+      shaders[i]->define("NOISE_OCTAVES",to_string(octaves));
+  }
+  _shaders->reloadAll();
 }
 
 void Viewer::createShaders() {
+  // binding point of the buffer created in createVAO
+  Shader::bindBlock("FrameData",0);
+
   _terrainShader = new Shader();
   _waterShader = new Shader();
   _treeShader = new Shader();
@@ -110,9 +157,20 @@ void Viewer::createShaders() {
   _terrainShader->load("shaders/terrain.vert","shaders/terrain.frag");
   _waterShader->load("shaders/water.vert","shaders/water.frag");
   _treeShader->load("shaders/cloud.vert", "shaders/cloud.frag");
+  _tess->createShader();
+
+  // rebuilt in the background when their files change
+  _shaders = new ShaderManager();
+  _shaders->add(_terrainShader);
+  _shaders->add(_waterShader);
+  _shaders->add(_treeShader);
+  _shaders->add(_tess->shader());
 }
 
 void Viewer::deleteShaders() {
+  delete _shaders;
+  _shaders = NULL;
+
   delete _terrainShader;
   delete _waterShader;
   delete _treeShader;
@@ -120,141 +178,127 @@ void Viewer::deleteShaders() {
   _terrainShader = NULL;
   _waterShader = NULL;
   _treeShader = NULL;
+  _tess->deleteShader();
 }
 
-void Viewer::createTextures(){
-    QImage image;
-    // enable the use of 2D textures
-    glEnable(GL_TEXTURE_2D);
-    // create one texture on the GPU
-    glGenTextures(1, _texIds);
-    // load an image (CPU side)
-    image = QGLWidget::convertToGLFormat(QImage("textures/grass_grass_0124_01_tiled.jpg"));
-     // activate this texture (the current one)
-     glBindTexture(GL_TEXTURE_2D,_texIds[0]);
-     // set texture parameters
-     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_MIRRORED_REPEAT);
-     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_MIRRORED_REPEAT);
-     // transfer data from CPU to GPU memory
-     glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,image.width(),image.height(),
-                  0, GL_RGBA,GL_UNSIGNED_BYTE,(const GLvoid *)image.bits());
-     // generate mipmaps
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // load an image (CPU side)
-    image = QGLWidget::convertToGLFormat(QImage("textures/gravel.jpg"));
-    // activate this texture (the current one)
-    glGenTextures(1, &_texIds[1]);
-    glBindTexture(GL_TEXTURE_2D,_texIds[1]);
-    // set texture parameters
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_MIRRORED_REPEAT);
-    // transfer data from CPU to GPU memory
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,image.width(),image.height(),
-                 0, GL_RGBA,GL_UNSIGNED_BYTE,(const GLvoid *)image.bits());
-    // generate mipmaps
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-
+void Viewer::createTextures() {
+  // terrain.frag lights the stored values and writes the result as it is:
+  // the maps stay linear (no Texture::SRGB) to give the same picture.
+  // Placeholders until paintGL uploads the decoded images
+  _textures = new TextureLoader();
+  _maps[0] = _textures->load("textures/grassTexture.jpg",Texture::COMPRESSED,GL_MIRRORED_REPEAT);
+  _maps[1] = _textures->load("textures/gravel.jpg",Texture::COMPRESSED,GL_MIRRORED_REPEAT);
 }
 
 void Viewer::deleteTextures() {
-    glDeleteTextures(1,_texIds);
-    glDeleteTextures(1,_texIdsBis);
+  delete _textures;
+  _textures = NULL;
 }
 
 void Viewer::reloadShaders() {
-  if(_terrainShader)
-    _terrainShader->reload("shaders/terrain.vert","shaders/terrain.frag");
-  if (_waterShader)
-      _waterShader->reload("shaders/water.vert","shaders/water.frag");
-  if (_treeShader)
-    _treeShader->reload("shaders/cloud.vert", "shaders/cloud.frag");
+  // swapped in by paintGL once linked / decoded
+  _shaders->reloadAll();
+  _textures->reloadAll();
 }
 
-void Viewer::drawAThree(const glm::vec3 &pos) {
-
-    const int id = _treeShader->id();
-    // send uniform variables
-    glm::mat4 mdv = glm::scale(_cam->mdvMatrix(), glm::vec3(0.0005));
-    mdv = glm::rotate(mdv, (float) 90, glm::vec3(0,1,0));
-    mdv = glm::rotate(mdv, (float) 15, glm::vec3(0,0,1));
-    mdv = glm::translate(mdv,pos);
+void Viewer::updateFrameData() {
+  FrameData d;
+  const glm::mat3 n = _cam->normalMatrix();
+
+  d.mdvMat  = _viewMatrix;
+  d.projMat = _projMatrix;
+  for(int i=0;i<3;++i)
+    d.normalMat[i] = glm::vec4(n[i],0.0f);
+  d.light    = _light;
+  d.y        = _y;
+  d.motion   = _motion;
+  d.t        = _t;
+  d.cloudMat = _cam->mdvMatrix();
+
+  glBindBuffer(GL_UNIFORM_BUFFER,_frameUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER,0,sizeof(FrameData),&d);
+  glBindBuffer(GL_UNIFORM_BUFFER,0);
+}
 
-    glUniformMatrix4fv(glGetUniformLocation(id,"mdvMat"),1,GL_FALSE,&(mdv[0][0]));
-    glUniformMatrix4fv(glGetUniformLocation(id,"projMat"),1,GL_FALSE,&(_projMatrix[0][0]));
-    glUniformMatrix3fv(glGetUniformLocation(id,"normalMat"),1,GL_FALSE,&(_cam->normalMatrix()[0][0]));
+void Viewer::drawThrees() {
+    // all the clouds at once (uniforms in FrameData, models per instance),
+    // each at the level of detail its distance allows
+    _clouds->draw(_treeShader,_cam->mdvMatrix(),_projMatrix,height(),_y);
+}
 
-    glUniform3fv(glGetUniformLocation(id,"light"),1,&(_light[0]));
-    glUniform3fv(glGetUniformLocation(id,"motion"),1,&(_motion[0]));
-    glUniform1f(glGetUniformLocation(id,"_y"),_y);
+void Viewer::drawScene(Shader *shader) {
+  // the terrain pass may use the tessellation program
+  const bool terrain = shader != _waterShader;
 
-    glDrawElements(GL_TRIANGLES, 3*_tree->nb_faces, GL_UNSIGNED_INT, (void *) 0);
+  // matrices, light, _y and _t come from the FrameData buffer
 
+    // send textures
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D,_textures->id(_maps[0]));
+    glUniform1i(shader->uniform("grassmap"),0);
+    if (terrain) {
+        glActiveTexture(GL_TEXTURE0+1);
+        glBindTexture(GL_TEXTURE_2D, _textures->id(_maps[1]));
+        glUniform1i(shader->uniform("gravelmap"), 1);
+
+        // cached heights (an empty area disables the cache)
+        if (_useHeightCache)
+            _heightCache->bind(shader,2);
+        else
+            glUniform4f(shader->uniform("cacheArea"),1.0f,-1.0f,1.0f,-1.0f);
+    }
+  // draw faces
+    drawTerrain(shader);
 }
 
-void Viewer::drawThrees(GLuint id) {
-    glBindVertexArray(_vaoThrees);
+void Viewer::drawTerrain(Shader *shader) {
+  // the camera rides the river: in terrain space it stays at x=0
+  glUniform3f(shader->uniform("camPos"),0.0f,_camY,_camZ);
+  // no geomorphing unless the LOD terrain asks for it
+  glUniform4f(shader->uniform("morph"),0.0f,0.0f,0.0f,0.0f);
+  glUniform1f(shader->uniform("clipmap"),0.0f);
 
-    // We draw some threes
-    const float r = _tree->radius*2.5;
-
-//    int nuages = 10;
-//    for (int i=-nuages; i<nuages; i++){
-//        drawAThree(glm::vec3(r*10,r*1.5,i*r));
-//    }
-
-    drawAThree(glm::vec3(r*1.5,r*1.5,r*1.5));
-    drawAThree(glm::vec3(r,r*1.35,r*2.6));
-    drawAThree(glm::vec3(r*2,r*0.8,r*-0.5));
-    drawAThree(glm::vec3(r*5,r*1,r*0.3));
-    drawAThree(glm::vec3(r*15,r*0.6,r*5.4));
-    drawAThree(glm::vec3(r*15,r*-0.4,r*-9.4));
+  if(_terrainMode==CHUNKED_TERRAIN) {
+    _chunks->draw(shader,_y);
+    return;
+  }
 
-    drawAThree(glm::vec3(-r*2,r*1.55,r*-1.4));
-    drawAThree(glm::vec3(-r*1.3,r*1.30,r*-1));
-    drawAThree(glm::vec3(-r*1.7,r*1.2,r*1.8));
+  if(_terrainMode==LOD_TERRAIN) {
+    _lod->draw(shader);
+    return;
+  }
 
-    glBindVertexArray(0);
-}
+  if(_terrainMode==CLIPMAP_TERRAIN) {
+    _clipmap->draw(shader);
+    return;
+  }
 
-void Viewer::drawScene(GLuint id) {
-  // send uniform variables
-
-  glUniformMatrix4fv(glGetUniformLocation(id,"mdvMat"),1,GL_FALSE,&(_viewMatrix[0][0]));
-  //glUniformMatrix4fv(glGetUniformLocation(id,"projMat"),1,GL_FALSE,&(_cam->projMatrix()[0][0]));
-  glUniformMatrix4fv(glGetUniformLocation(id,"projMat"),1,GL_FALSE,&(_projMatrix[0][0]));
-  glUniformMatrix3fv(glGetUniformLocation(id,"normalMat"),1,GL_FALSE,&(_cam->normalMatrix()[0][0]));
-  glUniform3fv(glGetUniformLocation(id,"light"),1,&(_light[0]));
-  glUniform3fv(glGetUniformLocation(id,"motion"),1,&(_motion[0]));
-  if (id == _terrainShader->id()) {
-      glUniform1f(glGetUniformLocation(id,"_y"),_y);
-  } else if (id == _waterShader->id()) {
-      glUniform1f(glGetUniformLocation(id,"_y"),_y);
-      glUniform1f(glGetUniformLocation(id,"_t"),_t);
+  // the water has no tessellation stages: it keeps the grid
+  if(_terrainMode==TESS_TERRAIN && shader!=_waterShader) {
+    _tess->draw(width(),height());
+    return;
   }
-    // send textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D,_texIds[0]);
-    glUniform1i(glGetUniformLocation(id,"grassmap"),0);
-    if (id == _terrainShader->id()) {
-        glActiveTexture(GL_TEXTURE0+1);
-        glBindTexture(GL_TEXTURE_2D, _texIds[1]);
-        glUniform1i(glGetUniformLocation(id, "gravelmap"), 1);
-    }
-  // draw faces
-    glBindVertexArray(_vaoTerrain);
-    glDrawElements(GL_TRIANGLES,3*_grid->nbFaces(),GL_UNSIGNED_INT,(void *)0);
-    glBindVertexArray(0);
+
+  // the grid, untransformed: only its visible patches when culling
+  glUniform3f(shader->uniform("tile"),0.0f,0.0f,1.0f);
+  _grid->setUniform(shader);
+  glBindVertexArray(_vaoTerrain);
+  if(_useCulling)
+    _culling->draw();
+  else
+    _grid->draw();
+  glBindVertexArray(0);
 }
 
 void Viewer::paintGL() {
+    _shaders->update();
+    _textures->update();
     if (_temps_moving) _t += .001;
     if (_moving) _y += _speed_y * 0.1;
+    if (_terrainMode==CHUNKED_TERRAIN) _chunks->update(_y);
+    if (_terrainMode==LOD_TERRAIN) _lod->update(glm::vec3(0.0f,_camY,_camZ));
+    if (_terrainMode==CLIPMAP_TERRAIN) _clipmap->update(_y);
+    if (_useHeightCache) _heightCache->update(_y);
   // allow opengl depth test 
   glEnable(GL_DEPTH_TEST);
 
@@ -268,10 +312,10 @@ void Viewer::paintGL() {
   // clear buffers
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   // move camera
-    float r = riverFlow(_y + -1);
+    float r = TerrainFunction::riverFlow(_y + -1);
     glm::vec3 camPos(r,_camY, _camZ);
     float lookahead = .9;
-  glm::vec3 center(_lookAtX + riverFlow(_y -1 +lookahead),0,0);
+  glm::vec3 center(_lookAtX + TerrainFunction::riverFlow(_y -1 +lookahead),0,0);
   glm::vec3 up(0, 0, 1);
   _viewMatrix = glm::lookAt(camPos, center, up);
 	float fovy = 45.0;
@@ -280,15 +324,43 @@ void Viewer::paintGL() {
 	float far = 500.0;
 	_projMatrix = glm::perspective(fovy, aspect, near, far);
 
+    // patches of the grid seen by the camera (shared by terrain and water)
+    if (_useCulling) _culling->update(_projMatrix*_viewMatrix,_y);
+
+    // uniforms shared by all the programs
+    updateFrameData();
+
     // trees
     glUseProgram(_treeShader->id());
-    drawThrees(_treeShader->id());
+    drawThrees();
+    // statistics of the terrain passes, once after key p
+    const bool measure = _measure && GLEW_ARB_pipeline_statistics_query;
+    if (measure) {
+      glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB,_queries[0]);
+      glBeginQuery(GL_PRIMITIVES_SUBMITTED_ARB,_queries[1]);
+    }
+
     // terrain
-    glUseProgram(_terrainShader->id());
-    drawScene(_terrainShader->id());
+    Shader *terrainShader = _terrainMode==TESS_TERRAIN ? _tess->shader() : _terrainShader;
+    glUseProgram(terrainShader->id());
+    drawScene(terrainShader);
     // water
     glUseProgram(_waterShader->id());
-    drawScene(_waterShader->id());
+    drawScene(_waterShader);
+
+    if (measure) {
+      glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+      glEndQuery(GL_PRIMITIVES_SUBMITTED_ARB);
+
+      GLuint64 runs,triangles;
+      glGetQueryObjectui64v(_queries[0],GL_QUERY_RESULT,&runs);
+      glGetQueryObjectui64v(_queries[1],GL_QUERY_RESULT,&triangles);
+      cout << "Terrain and water: " << runs << " vertex shader runs, " << triangles << " triangles ("
+	   << (triangles ? (double)runs/(double)triangles : 0.0) << " per triangle)" << endl;
+    } else if (_measure) {
+      cout << "Pipeline statistics queries are not supported" << endl;
+    }
+    _measure = false;
 
 
 //  drawScene(_waterShader->id());
@@ -397,10 +469,10 @@ void Viewer::keyPressEvent(QKeyEvent *ke) {
 //        //info
 //        printf("Info :\n");
 //
-//        float r = riverFlow(_y + _camY);
+//        float r = TerrainFunction::riverFlow(_y + _camY);
 //        printf("\tCamera (r,_CamY, _CamZ) = (%f,%f,%f)\n",r ,_camY, _camZ);
 //        printf("\tCamera lookAtX = %f\n",_lookAtX);
-//        printf("\t_y = %f and riverflow(_y) = %f \n",_y, riverFlow(_y));
+//        printf("\t_y = %f and riverflow(_y) = %f \n",_y, TerrainFunction::riverFlow(_y));
 //        printf("\ttime _t : %f \n", _t);
 //
 //    }
@@ -437,11 +509,85 @@ void Viewer::keyPressEvent(QKeyEvent *ke) {
   //   cout << "FPS : " << t*1000.0 << endl;
   // }
 
-  // key r: reload shaders 
+  // key r: reload shaders and textures
   if(ke->key()==Qt::Key_R) {
     reloadShaders();
   }
 
+  // key h: use/ignore the height cache
+  if(ke->key()==Qt::Key_H) {
+    _useHeightCache = not _useHeightCache;
+  }
+
+  // key c: cull/draw all the grid patches
+  if(ke->key()==Qt::Key_C) {
+    _useCulling = not _useCulling;
+  }
+
+  // key +/-: finer/coarser tessellation
+  if(ke->key()==Qt::Key_Plus) {
+    _tess->setTessError(_tess->tessError()*0.5f);
+    cout << "Tessellation error: " << _tess->tessError() << " pixels" << endl;
+  }
+  if(ke->key()==Qt::Key_Minus) {
+    _tess->setTessError(_tess->tessError()*2.0f);
+    cout << "Tessellation error: " << _tess->tessError() << " pixels" << endl;
+  }
+
+  // key n/b: more/fewer clouds
+  if(ke->key()==Qt::Key_N) {
+    _clouds->setNbClouds(std::max(1u,_clouds->nbClouds()*2));
+    cout << "Clouds: " << _clouds->nbClouds() << endl;
+  }
+  if(ke->key()==Qt::Key_B) {
+    _clouds->setNbClouds(_clouds->nbClouds()/2);
+    cout << "Clouds: " << _clouds->nbClouds() << endl;
+  }
+
+  // key g: topology of the grid (rows / bands / strips)
+  if(ke->key()==Qt::Key_G) {
+    static const char *names[Grid::NB_TOPOLOGIES] = {"rows","bands","strips"};
+    setGrid(_ndResol,(Grid::Topology)((_grid->topology()+1)%Grid::NB_TOPOLOGIES));
+    cout << "Grid topology: " << names[_grid->topology()] << endl;
+  }
+
+  // key page up/down: finer/coarser grid
+  if(ke->key()==Qt::Key_PageUp && _ndResol<4096) {
+    setGrid(_ndResol*2,_grid->topology());
+  }
+  if(ke->key()==Qt::Key_PageDown && _ndResol>64) {
+    setGrid(_ndResol/2,_grid->topology());
+  }
+
+  // key p: measure the vertex shader runs of the next frame
+  if(ke->key()==Qt::Key_P) {
+    _measure = true;
+  }
+
+  // key o: noise octaves of the terrain and water (1 to 3, 2 matches
+  // TerrainFunction)
+  if(ke->key()==Qt::Key_O) {
+    setNoiseOctaves(_noiseOctaves%3+1);
+    cout << "Noise octaves: " << _noiseOctaves << endl;
+  }
+
+  // key l: clouds with/without levels of detail
+  if(ke->key()==Qt::Key_L) {
+    _clouds->setUseLod(!_clouds->useLod());
+    cout << "Cloud LOD: " << (_clouds->useLod() ? "on" : "off") << ", "
+	 << _clouds->nbTriangles() << " triangles in the last frame" << endl;
+  }
+
+  // key t: switch terrain mode (full grid / chunks / LOD / clipmap / tessellation)
+  if(ke->key()==Qt::Key_T) {
+    _terrainMode = (_terrainMode+1)%NB_TERRAIN_MODES;
+    if(_terrainMode==TESS_TERRAIN && !_tess->shader())
+      _terrainMode = (_terrainMode+1)%NB_TERRAIN_MODES;
+    if(_terrainMode==CHUNKED_TERRAIN) _chunks->update(_y);
+    if(_terrainMode==LOD_TERRAIN) _lod->update(glm::vec3(0.0f,_camY,_camZ));
+    if(_terrainMode==CLIPMAP_TERRAIN) _clipmap->update(_y);
+  }
+
   updateGL();
 }
 
@@ -467,17 +613,12 @@ void Viewer::initializeGL() {
 
   // init shaders 
   createShaders();
+  _heightCache->create();
+  _shaders->add(_heightCache->shader(),[this]() {_heightCache->invalidate();});
 
   // init VAO/VBO
   createVAO();
-  loadMeshIntoVAO();
   createTextures();
   // starts the timer 
   _timer->start();
 }
-
-float Viewer::riverFlow(float t){
-    //return .5*sin(t*3);
-    float l = .2;
-    return .5*sin(t*3*l) + .2*sin(t*8*l) + 2*sin(t*0.2*l);
-}
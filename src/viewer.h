@@ -23,8 +23,18 @@
 
 #include "camera.h"
 #include "shader.h"
+#include "shaderManager.h"
 #include "grid.h"
+#include "terrainChunks.h"
+#include "terrainLod.h"
+#include "terrainClipmap.h"
+#include "heightCache.h"
+#include "terrainTess.h"
+#include "terrainCulling.h"
+#include "cloudField.h"
 #include "meshLoader.h"
+#include "threadPool.h"
+#include "textureLoader.h"
 
 class Viewer : public QGLWidget {
  public:
@@ -44,27 +54,47 @@ class Viewer : public QGLWidget {
   void createVAO();
   void deleteVAO();
 
+  // rebuild the grid of the terrain and water (resol x resol vertices)
+  void setGrid(unsigned int resol,Grid::Topology topology);
+
+  // quality tier of the terrain and water shaders (NOISE_OCTAVES of
+  // shaders/noise.glsl), applied by the hot reload
+  void setNoiseOctaves(unsigned int octaves);
+
   void createTextures();
    void deleteTextures();
-  GLuint _texIds[3];
-  GLuint _texIdsBis[3];
-
-  void loadMeshIntoVAO();
+  TextureLoader        *_textures; // decoded in the background, streamed by paintGL
+  TextureLoader::Handle _maps[2];  // grass, gravel
 
   void createShaders();
   void deleteShaders();
   void reloadShaders();
 
+  // per-frame uniforms of all the programs
+  void updateFrameData();
+
   // drawing functions
-  void drawScene(GLuint id);
-  void drawThrees(GLuint id);
-  void drawAThree(const glm::vec3 &pos);
+  void drawScene(Shader *shader);
+  void drawTerrain(Shader *shader);
+  void drawThrees();
 
   QTimer        *_timer;    // timer that controls the animation
   void QtTimerEvt();
 
-  Grid   *_grid;   // the grid
-  Camera *_cam;    // the camera
+  // how the terrain geometry is generated
+  enum TerrainMode {GRID_TERRAIN, CHUNKED_TERRAIN, LOD_TERRAIN, CLIPMAP_TERRAIN, TESS_TERRAIN, NB_TERRAIN_MODES};
+
+  Grid          *_grid;        // the grid
+  TerrainChunks *_chunks;      // streamed terrain chunks
+  TerrainLod    *_lod;         // quadtree LOD terrain
+  TerrainClipmap *_clipmap;    // geometry clipmap terrain
+  HeightCache   *_heightCache; // cached terrain heights/normals
+  TerrainTess   *_tess;        // tessellated terrain (GL 4.0)
+  TerrainCulling *_culling;    // visible patches of the grid
+  bool           _useCulling;
+  bool           _useHeightCache;
+  int            _terrainMode; // one of TerrainMode
+  Camera        *_cam;         // the camera
 
   glm::vec3 _light;  // light direction
   glm::vec3 _motion; // motion offset for the noise texture
@@ -74,7 +104,6 @@ class Viewer : public QGLWidget {
   bool _temps_moving;
   float _speed_y;
   bool _moving;
-  float riverFlow(float t);
 
   float _camX;
   float _camY;
@@ -91,16 +120,36 @@ class Viewer : public QGLWidget {
   Shader *_terrainShader;
   Shader *_waterShader;
   Shader *_treeShader;
+  ShaderManager *_shaders; // hot reload of all the programs
+  unsigned int   _noiseOctaves;
+
+  // std140 layout of the FrameData uniform block of the shaders
+  struct FrameData {
+    glm::mat4 mdvMat;
+    glm::mat4 projMat;
+    glm::vec4 normalMat[3]; // mat3: one vec4 per column
+    glm::vec3 light;
+    float     y;
+    glm::vec3 motion;
+    float     t;
+    glm::mat4 cloudMat;
+  };
+
+  GLuint _frameUbo; // uniform buffer holding a FrameData
 
   // vbo/vao ids 
   GLuint _vaoTerrain;
   GLuint _terrain[2];
 
   Mesh *_tree;
-  GLuint _vaoThrees;
-  GLuint _buffers[3];
+  CloudField *_clouds; // instanced clouds
 
   unsigned int _ndResol;
+  ThreadPool  *_pool; // generates the grid
+
+  // pipeline statistics queries (key p): vertex shader runs, triangles
+  GLuint _queries[2];
+  bool   _measure;
 };
 
 #endif // VIEWER_H